@@ -0,0 +1,768 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <error.h>
+
+#include <systemd/sd-id128.h>
+
+#define ADV_IFACE "org.bluez.LEAdvertisement1"
+#define ADV_MANAGER "org.bluez.LEAdvertisingManager1"
+
+#define SLEEP_MATCH \
+    "type='signal',sender='org.freedesktop.login1'," \
+    "interface='org.freedesktop.login1.Manager',member='PrepareForSleep'"
+
+#define UNLOCK_MATCH \
+    "type='signal',sender='org.freedesktop.login1'," \
+    "interface='org.freedesktop.login1.Session',member='Unlock'"
+
+#define OWNER_MATCH \
+    "type='signal',sender='org.freedesktop.DBus'," \
+    "interface='org.freedesktop.DBus',member='NameOwnerChanged'," \
+    "arg0='org.bluez'"
+
+/*
+ * The host tag: a version byte and the first TAG_SIZE - 1 bytes of a
+ * SipHash of the seat name, keyed with a per-application hash of the
+ * machine ID. It is stable across reboots but does not reveal the machine
+ * ID, and fits in a legacy advertisement beside the 128-bit service UUID.
+ * FreeOTP has no company identifier, so the one reserved for testing is
+ * used.
+ */
+#define TAG_APP SD_ID128_MAKE(92,e2,a4,72,b2,f8,4a,db,89,dd,37,ea,8a,b2,2e,c3)
+#define TAG_COMPANY 0xffff
+#define TAG_VERSION 0x01
+#define TAG_SIZE 6
+
+#define CONNECTED_MAX 8
+
+/*
+ * The advertisement. Its optional properties each live in a vtable of
+ * their own, added to ADV_PATH only when wanted, so that bluez sees
+ * exactly the settings it was asked for. sd-bus takes several vtables for
+ * one interface as long as their members differ. Those the adapter reports
+ * it cannot honour are removed again before the advertisement is
+ * registered.
+ *
+ * Advertising runs fast for a while after startup, resume, unlock or a
+ * Burst() call, then slows down, and stops while a phone that has written
+ * to us stays connected or while nobody is at the seat (see session.c).
+ * bluez reads an advertisement's properties only when it is registered, so
+ * each change re-registers it with every adapter. Once bluez releases the
+ * advertisement, at --adv-timeout, it stays off until the next burst.
+ * Phones count as connected until bluez says otherwise, removes them or
+ * goes away.
+ */
+
+enum adv_option {
+    ADV_INTERVAL = 0,
+    ADV_TX_POWER,
+    ADV_DURATION,
+    ADV_TIMEOUT,
+    ADV_SECONDARY,
+    ADV_TAG,
+    ADV_OPTIONS
+};
+
+enum adv_mode {
+    ADV_FAST = 0,
+    ADV_SLOW,
+    ADV_PAUSED,
+};
+
+static struct {
+    sd_bus *bus;
+    sd_event *event;
+    sd_bus_slot *slots[ADV_OPTIONS];
+    bool unsupported[ADV_OPTIONS];
+    struct timer burst;
+    bool bursting;
+    bool blocked;
+    bool released;
+    enum adv_mode mode;
+    uint64_t since;
+    uint64_t burst_at;
+    uint32_t min_interval;
+    uint32_t max_interval;
+    uint8_t tag[TAG_SIZE];
+    size_t nadapters;
+    char adapters[ADAPTER_MAX][DEVICE_MAX];
+    size_t nconnected;
+    char connected[CONNECTED_MAX][DEVICE_MAX];
+} adv;
+
+static int
+get_type(sd_bus *bus, const char *path, const char *interface,
+         const char *property, sd_bus_message *reply, void *userdata,
+         sd_bus_error *ret_error)
+{
+    return sd_bus_message_append(reply, "s", "peripheral");
+}
+
+static int
+get_uuids(sd_bus *bus, const char *path, const char *interface,
+          const char *property, sd_bus_message *reply, void *userdata,
+          sd_bus_error *ret_error)
+{
+    return sd_bus_message_append(reply, "as", 1, SVC_UUID);
+}
+
+static int
+get_includes(sd_bus *bus, const char *path, const char *interface,
+             const char *property, sd_bus_message *reply, void *userdata,
+             sd_bus_error *ret_error)
+{
+    return sd_bus_message_append(reply, "as", 1, "local-name");
+}
+
+static int
+get_min_interval(sd_bus *bus, const char *path, const char *interface,
+                 const char *property, sd_bus_message *reply, void *userdata,
+                 sd_bus_error *ret_error)
+{
+    return sd_bus_message_append(reply, "u", adv.min_interval);
+}
+
+static int
+get_max_interval(sd_bus *bus, const char *path, const char *interface,
+                 const char *property, sd_bus_message *reply, void *userdata,
+                 sd_bus_error *ret_error)
+{
+    return sd_bus_message_append(reply, "u", adv.max_interval);
+}
+
+static int
+get_tx_power(sd_bus *bus, const char *path, const char *interface,
+             const char *property, sd_bus_message *reply, void *userdata,
+             sd_bus_error *ret_error)
+{
+    return sd_bus_message_append(reply, "n", config.adv_tx_power);
+}
+
+static int
+get_duration(sd_bus *bus, const char *path, const char *interface,
+             const char *property, sd_bus_message *reply, void *userdata,
+             sd_bus_error *ret_error)
+{
+    return sd_bus_message_append(reply, "q", config.adv_duration);
+}
+
+static int
+get_timeout(sd_bus *bus, const char *path, const char *interface,
+            const char *property, sd_bus_message *reply, void *userdata,
+            sd_bus_error *ret_error)
+{
+    return sd_bus_message_append(reply, "q", config.adv_timeout);
+}
+
+static int
+get_secondary(sd_bus *bus, const char *path, const char *interface,
+              const char *property, sd_bus_message *reply, void *userdata,
+              sd_bus_error *ret_error)
+{
+    return sd_bus_message_append(reply, "s", config.adv_secondary);
+}
+
+static int
+get_manufacturer(sd_bus *bus, const char *path, const char *interface,
+                 const char *property, sd_bus_message *reply, void *userdata,
+                 sd_bus_error *ret_error)
+{
+    int r;
+
+    r = sd_bus_message_open_container(reply, 'a', "{qv}");
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_open_container(reply, 'e', "qv");
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_append(reply, "q", TAG_COMPANY);
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_open_container(reply, 'v', "ay");
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_append_array(reply, 'y', adv.tag, sizeof(adv.tag));
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_close_container(reply);
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_close_container(reply);
+    if (r < 0)
+        return r;
+
+    return sd_bus_message_close_container(reply);
+}
+
+static void
+refresh(void);
+
+/* bluez dropped the advertisement, which it does at its Timeout. */
+static int
+meth_release(sd_bus_message *m, void *misc, sd_bus_error *err)
+{
+    if (!adv.released) {
+        fprintf(stderr, "Advertisement released by bluez\n");
+        adv.released = true;
+        refresh();
+    }
+
+    return sd_bus_reply_method_return(m, "");
+}
+
+static int
+meth_burst(sd_bus_message *m, void *misc, sd_bus_error *err)
+{
+    advertising_burst("request");
+    return sd_bus_reply_method_return(m, "");
+}
+
+const sd_bus_vtable adv_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    PROP("Type", "s", get_type),
+    PROP("ServiceUUIDs", "as", get_uuids),
+    PROP("Includes", "as", get_includes),
+    METH("Release", "", "", meth_release),
+    SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable interval_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    PROP("MinInterval", "u", get_min_interval),
+    PROP("MaxInterval", "u", get_max_interval),
+    SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable tx_power_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    PROP("TxPower", "n", get_tx_power),
+    SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable duration_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    PROP("Duration", "q", get_duration),
+    SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable timeout_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    PROP("Timeout", "q", get_timeout),
+    SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable secondary_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    PROP("SecondaryChannel", "s", get_secondary),
+    SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable tag_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    PROP("ManufacturerData", "a{qv}", get_manufacturer),
+    SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable ctl_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    METH("Burst", "", "", meth_burst),
+    SD_BUS_VTABLE_END
+};
+
+static const struct {
+    const sd_bus_vtable *vtable;
+    const char *name;
+} options[ADV_OPTIONS] = {
+    [ADV_INTERVAL] = { interval_vtable, "advertising interval" },
+    [ADV_TX_POWER] = { tx_power_vtable, "advertising TX power" },
+    [ADV_DURATION] = { duration_vtable, "advertising duration" },
+    [ADV_TIMEOUT] = { timeout_vtable, "advertising timeout" },
+    [ADV_SECONDARY] = { secondary_vtable, "secondary channel" },
+    [ADV_TAG] = { tag_vtable, "host tag" },
+};
+
+static bool
+wanted(enum adv_option o)
+{
+    if (adv.unsupported[o])
+        return false;
+
+    switch (o) {
+    case ADV_INTERVAL: return adv.max_interval > 0;
+    case ADV_TX_POWER: return config.adv_tx_power != ADV_TX_POWER_UNSET;
+    case ADV_DURATION: return config.adv_duration > 0;
+    case ADV_TIMEOUT: return config.adv_timeout > 0;
+    case ADV_SECONDARY: return config.adv_secondary != NULL;
+    case ADV_TAG: return adv.tag[0] == TAG_VERSION;
+    default: return false;
+    }
+}
+
+/* Adds or removes the optional properties to match what is wanted now. */
+static void
+attach(void)
+{
+    int r;
+
+    for (size_t i = 0; adv.bus && i < ADV_OPTIONS; i++) {
+        if (!wanted(i)) {
+            adv.slots[i] = sd_bus_slot_unref(adv.slots[i]);
+            continue;
+        }
+
+        if (adv.slots[i])
+            continue;
+
+        r = sd_bus_add_object_vtable(adv.bus, &adv.slots[i], ADV_PATH,
+                                     ADV_IFACE, options[i].vtable, NULL);
+        if (r < 0)
+            fprintf(stderr, "Error setting %s: %s\n", options[i].name,
+                    strerror(-r));
+    }
+}
+
+static void
+unsupported(enum adv_option o)
+{
+    if (adv.unsupported[o] || !wanted(o))
+        return;
+
+    fprintf(stderr, "Bluez cannot set the %s; leaving it to bluez\n",
+            options[o].name);
+    adv.unsupported[o] = true;
+    attach();
+}
+
+static int
+on_registered(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    if (sd_bus_error_is_set(ret_error)) {
+        fprintf(stderr, "Error registering advertisement: %s: %s\n",
+                ret_error->name, ret_error->message);
+        return 0;
+    }
+
+    startup_mark(STARTUP_ADVERTISING);
+    return 0;
+}
+
+/* Not being registered is just as good, so errors do not matter. */
+static int
+on_unregistered(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    return 0;
+}
+
+static void
+call(const char *adapter, const char *method)
+{
+    int r;
+
+    if (strcmp(method, "RegisterAdvertisement") == 0) {
+        r = sd_bus_call_method_async(adv.bus, NULL, "org.bluez", adapter,
+                                     ADV_MANAGER, method, on_registered,
+                                     NULL, "oa{sv}", ADV_PATH, 0);
+    } else {
+        r = sd_bus_call_method_async(adv.bus, NULL, "org.bluez", adapter,
+                                     ADV_MANAGER, method, on_unregistered,
+                                     NULL, "o", ADV_PATH);
+    }
+    if (r < 0)
+        fprintf(stderr, "Error calling %s on %s: %s\n", method, adapter,
+                strerror(-r));
+}
+
+/* Moves to the mode the current state calls for and tells bluez. */
+static void
+refresh(void)
+{
+    uint64_t now = timer_now(adv.event);
+    uint64_t *spent[] = {
+        [ADV_FAST] = &stats.adv_fast_usec,
+        [ADV_SLOW] = &stats.adv_slow_usec,
+        [ADV_PAUSED] = &stats.adv_paused_usec,
+    };
+    enum adv_mode mode = ADV_SLOW;
+    enum adv_mode was = adv.mode;
+
+    if (adv.blocked || adv.released || adv.nconnected > 0)
+        mode = ADV_PAUSED;
+    else if (adv.bursting)
+        mode = ADV_FAST;
+
+    *spent[was] += now - adv.since;
+    adv.since = now;
+    adv.mode = mode;
+
+    adv.min_interval = config.adv_min_interval;
+    adv.max_interval = config.adv_max_interval;
+    if (mode == ADV_FAST) {
+        adv.min_interval = config.adv_burst_min;
+        adv.max_interval = config.adv_burst_max;
+    }
+    attach();
+
+    if (mode == was)
+        return;
+
+    for (size_t i = 0; adv.bus && i < adv.nadapters; i++) {
+        if (was != ADV_PAUSED)
+            call(adv.adapters[i], "UnregisterAdvertisement");
+        if (mode != ADV_PAUSED)
+            call(adv.adapters[i], "RegisterAdvertisement");
+    }
+}
+
+static int
+on_burst_end(sd_event_source *s, uint64_t usec, void *misc)
+{
+    adv.bursting = false;
+    refresh();
+    return 0;
+}
+
+/* Advertises fast for a while, so that phones find us sooner. */
+void
+advertising_burst(const char *why)
+{
+    bool released = adv.released;
+    int r;
+
+    adv.released = false;
+    if (config.adv_burst_usec == 0) {
+        if (released)
+            refresh();
+        return;
+    }
+
+    fprintf(stderr, "Advertising fast after %s\n", why);
+    stats.adv_bursts++;
+    adv.burst_at = timer_now(adv.event);
+
+    r = timer_start(&adv.burst, adv.event, config.adv_burst_usec);
+    if (r < 0) {
+        fprintf(stderr, "Error timing advertising burst: %s\n",
+                strerror(-r));
+        return;
+    }
+
+    if (!adv.bursting || released) {
+        adv.bursting = true;
+        refresh();
+    }
+}
+
+/*
+ * A phone found us and wrote: that ends the wait since the last burst.
+ * Advertising pauses until it disconnects, if we can tell when it does.
+ */
+void
+advertising_seen(const char *device)
+{
+    uint64_t now = timer_now(adv.event);
+
+    if (adv.burst_at != 0) {
+        stats.discovery_last_usec = now - adv.burst_at;
+        if (stats.discovery_last_usec > stats.discovery_max_usec)
+            stats.discovery_max_usec = stats.discovery_last_usec;
+        adv.burst_at = 0;
+    }
+
+    if (device[0] == '\0' || adv.nconnected == CONNECTED_MAX)
+        return;
+
+    for (size_t i = 0; i < adv.nconnected; i++) {
+        if (strncmp(adv.connected[i], device, DEVICE_MAX - 1) == 0)
+            return;
+    }
+
+    snprintf(adv.connected[adv.nconnected++], DEVICE_MAX, "%s", device);
+    if (adv.nconnected == 1)
+        refresh();
+}
+
+/* A device went away, or every device below path did; see connection.c. */
+void
+advertising_disconnected(const char *path)
+{
+    size_t len = strlen(path);
+    size_t was = adv.nconnected;
+
+    for (size_t i = adv.nconnected; i-- > 0; ) {
+        const char *c = adv.connected[i];
+
+        if (strncmp(c, path, len) != 0 || (c[len] != '\0' && c[len] != '/'))
+            continue;
+
+        memcpy(adv.connected[i], adv.connected[--adv.nconnected],
+               DEVICE_MAX);
+    }
+
+    /* The burst refreshes only if none was running, or bursts are off. */
+    if (was > 0 && adv.nconnected == 0) {
+        advertising_burst("disconnect");
+        refresh();
+    }
+}
+
+static int
+on_sleep(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    int sleeping = true;
+
+    if (sd_bus_message_read(m, "b", &sleeping) >= 0 && !sleeping)
+        advertising_burst("resume");
+
+    return 0;
+}
+
+static int
+on_unlock(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    advertising_burst("unlock");
+    return 0;
+}
+
+/*
+ * bluez went away, and with it every connection and registration. The
+ * adapters come back through advertising_add() once it returns.
+ */
+static int
+on_owner(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    const char *name = NULL;
+    const char *old = NULL;
+    const char *new = NULL;
+
+    if (sd_bus_message_read(m, "sss", &name, &old, &new) < 0 || new[0])
+        return 0;
+
+    adv.nadapters = 0;
+    adv.nconnected = 0;
+    adv.released = false;
+    refresh();
+    return 0;
+}
+
+/* Reads a variant holding an "as", noting whether want is among it. */
+static int
+contains(sd_bus_message *m, const char *want, bool *found)
+{
+    const char *s = NULL;
+    int r;
+
+    r = sd_bus_message_enter_container(m, 'v', "as");
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_enter_container(m, 'a', "s");
+    if (r < 0)
+        return r;
+
+    while ((r = sd_bus_message_read(m, "s", &s)) > 0)
+        *found = *found || (want && strcmp(s, want) == 0);
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_exit_container(m);
+    if (r < 0)
+        return r;
+
+    return sd_bus_message_exit_container(m);
+}
+
+/*
+ * Reads the properties of an adapter's LEAdvertisingManager1 and drops the
+ * settings it does not list as supported. A bluez too old to list them
+ * supports neither.
+ */
+int
+advertising_check(sd_bus_message *m)
+{
+    bool tx_power = false;
+    bool secondary = false;
+    int r;
+
+    r = sd_bus_message_enter_container(m, 'a', "{sv}");
+    if (r < 0)
+        return r;
+
+    while ((r = sd_bus_message_enter_container(m, 'e', "sv")) > 0) {
+        const char *key = NULL;
+
+        r = sd_bus_message_read(m, "s", &key);
+        if (r < 0)
+            return r;
+
+        if (strcmp(key, "SupportedFeatures") == 0)
+            r = contains(m, "CanSetTxPower", &tx_power);
+        else if (strcmp(key, "SupportedSecondaryChannels") == 0)
+            r = contains(m, config.adv_secondary, &secondary);
+        else
+            r = sd_bus_message_skip(m, "v");
+        if (r < 0)
+            return r;
+
+        r = sd_bus_message_exit_container(m);
+        if (r < 0)
+            return r;
+    }
+    if (r < 0)
+        return r;
+
+    if (!tx_power)
+        unsupported(ADV_TX_POWER);
+    if (!secondary)
+        unsupported(ADV_SECONDARY);
+
+    return sd_bus_message_exit_container(m);
+}
+
+/*
+ * Starts or stops advertising as the session on our seat comes and goes;
+ * see session.c. Someone who just sat down gets a burst.
+ */
+void
+advertising_allow(bool allowed)
+{
+    if (adv.blocked == !allowed)
+        return;
+
+    fprintf(stderr, "%s advertising for the session on %s\n",
+            allowed ? "Resuming" : "Stopping", config.seat);
+    adv.blocked = !allowed;
+    refresh();
+
+    if (allowed)
+        advertising_burst("session change");
+}
+
+/* Registers the advertisement with a newly found adapter. */
+void
+advertising_add(sd_bus *bus, const char *adapter)
+{
+    size_t i;
+
+    for (i = 0; i < adv.nadapters; i++) {
+        if (strncmp(adv.adapters[i], adapter, DEVICE_MAX - 1) == 0)
+            break;
+    }
+
+    if (i == ADAPTER_MAX) {
+        fprintf(stderr, "Not advertising on %s: too many adapters\n",
+                adapter);
+        return;
+    }
+
+    if (i == adv.nadapters)
+        snprintf(adv.adapters[adv.nadapters++], DEVICE_MAX, "%s", adapter);
+
+    if (!adv.bus)
+        adv.bus = bus;
+
+    if (adv.mode != ADV_PAUSED)
+        call(adv.adapters[i], "RegisterAdvertisement");
+}
+
+/* Derives the host tag, leaving it out if there is no machine ID. */
+static void
+tag(void)
+{
+    sd_id128_t key;
+    uint64_t hash;
+    int r;
+
+    if (!config.adv_tag)
+        return;
+
+    r = sd_id128_get_machine_app_specific(TAG_APP, &key);
+    if (r < 0) {
+        fprintf(stderr, "Error deriving host tag: %s; not advertising it\n",
+                strerror(-r));
+        return;
+    }
+
+    hash = siphash24(key.bytes, (const uint8_t *) config.seat,
+                     strlen(config.seat));
+    memset(&key, 0, sizeof(key));
+
+    adv.tag[0] = TAG_VERSION;
+    for (size_t i = 1; i < TAG_SIZE; i++)
+        adv.tag[i] = hash >> (8 * (i - 1));
+
+    fprintf(stderr, "Advertising host tag %02x%02x%02x%02x%02x for %s\n",
+            adv.tag[1], adv.tag[2], adv.tag[3], adv.tag[4], adv.tag[5],
+            config.seat);
+}
+
+void
+setup_advertising(sd_bus *bus, sd_event *event)
+{
+    static const struct {
+        const char *match;
+        sd_bus_message_handler_t handler;
+    } matches[] = {
+        { SLEEP_MATCH, on_sleep },
+        { UNLOCK_MATCH, on_unlock },
+        { OWNER_MATCH, on_owner },
+    };
+
+    int r;
+
+    adv.bus = bus;
+    adv.event = event;
+    adv.burst = (struct timer) { .handler = on_burst_end };
+    adv.mode = ADV_SLOW;
+    adv.since = timer_now(event);
+    tag();
+
+    r = sd_bus_add_object_vtable(bus, NULL, ADV_PATH, ADV_IFACE,
+                                 adv_vtable, NULL);
+    if (r < 0)
+        error(EXIT_FAILURE, -r, "Error creating advertisement");
+
+    r = sd_bus_add_object_vtable(bus, NULL, ADV_PATH, CTL_IFACE,
+                                 ctl_vtable, NULL);
+    if (r < 0)
+        error(EXIT_FAILURE, -r, "Error creating advertising control");
+
+    /* Triggers only: advertising works without them. */
+    for (size_t i = 0; i < COUNT(matches); i++) {
+        r = sd_bus_add_match_async(bus, NULL, matches[i].match,
+                                   matches[i].handler, NULL, NULL);
+        if (r < 0)
+            fprintf(stderr, "Error watching for advertising triggers: %s\n",
+                    strerror(-r));
+    }
+
+    refresh();
+    advertising_burst("startup");
+}
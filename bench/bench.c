@@ -0,0 +1,354 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "harness.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Microbenchmarks for the daemon's hot paths. Each benchmark is calibrated
+ * to run for at least BENCH_TIME seconds (default 0.25) and reports one
+ * JSON object per line on stdout:
+ *
+ *   {"name": "validate/6", "iterations": 4194304, "ns_per_op": 9.81}
+ *
+ * An optional argument restricts the run to names containing it.
+ */
+
+#define OBJECTS_PATH "/org/bluez/hci0/dev_00_11_22_33_44_%02X_%02X"
+
+/* Distinct values bench_writevalue() cycles through; above DEDUP_MAX. */
+#define WRITES 64
+
+typedef void (*bench_fn)(size_t iters, void *arg);
+
+static volatile uint64_t bench_sink;
+static const char *bench_filter;
+static double bench_time = 0.25;
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+run(const char *name, bench_fn fn, void *arg)
+{
+    uint64_t goal = bench_time * 1000000000;
+    uint64_t elapsed = 0;
+    size_t iters = 1;
+
+    if (bench_filter && !strstr(name, bench_filter))
+        return;
+
+    /* Grow the batch until it is long enough to time, then scale it up. */
+    for (;;) {
+        uint64_t start = now_ns();
+        fn(iters, arg);
+        elapsed = now_ns() - start;
+
+        if (elapsed >= goal)
+            break;
+
+        if (elapsed < goal / 100)
+            iters *= 10;
+        else
+            iters = iters * goal / elapsed * 11 / 10 + 1;
+    }
+
+    printf("{\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.2f}\n",
+           name, iters, (double) elapsed / iters);
+    fflush(stdout);
+}
+
+static sd_bus_message *
+new_writevalue(const char *value)
+{
+    sd_bus_message *m = NULL;
+
+    if (sd_bus_message_new_method_call(harness_bus(), &m, NULL, CHR_PATH,
+                                       "org.bluez.GattCharacteristic1",
+                                       "WriteValue") < 0 ||
+        sd_bus_message_append_array(m, 'y', value, strlen(value)) < 0 ||
+        sd_bus_message_append(m, "a{sv}", 0) < 0 ||
+        harness_seal(m) < 0)
+        abort();
+
+    return m;
+}
+
+static void
+bench_validate(size_t iters, void *arg)
+{
+    static const uint8_t payload[] = "01234567890123456789012345678901";
+    size_t size = (uintptr_t) arg;
+    uint64_t bad = 0;
+
+    for (size_t i = 0; i < iters; i++) {
+        for (size_t j = 0; j < size; j++)
+            bad += char2key(payload[j]) == KEY_UNKNOWN;
+    }
+
+    bench_sink += bad;
+}
+
+static void
+bench_frame(size_t iters, void *arg)
+{
+    struct input_event evts[2];
+    uint64_t n = 0;
+
+    for (size_t i = 0; i < iters; i++) {
+        n += event_frame(evts, char2key('0' + i % 10), true);
+        n += event_frame(evts, char2key('0' + i % 10), false);
+        n += event_frame(evts, KEY_UNKNOWN, false);
+        n += evts[0].type;
+    }
+
+    bench_sink += n;
+}
+
+static void
+bench_reply_return(size_t iters, void *arg)
+{
+    SCOPED(sd_bus_message) *call = new_writevalue("123456");
+
+    for (size_t i = 0; i < iters; i++) {
+        sd_bus_message *reply = NULL;
+
+        if (sd_bus_message_new_method_return(call, &reply) < 0)
+            abort();
+
+        sd_bus_message_unref(reply);
+    }
+}
+
+static void
+bench_reply_error(size_t iters, void *arg)
+{
+    SCOPED(sd_bus_message) *call = new_writevalue("123456");
+
+    for (size_t i = 0; i < iters; i++) {
+        sd_bus_message *reply = NULL;
+
+        if (sd_bus_message_new_method_errorf(call, &reply,
+                                             "org.bluez.Error.NotPermitted",
+                                             "Invalid value") < 0)
+            abort();
+
+        sd_bus_message_unref(reply);
+    }
+}
+
+/*
+ * Cycles through more distinct values than the dedup cache holds, with
+ * rate limiting off, so that every call is a whole WriteValue rather than
+ * the early return for a duplicate or a rate limited write.
+ */
+static void
+bench_writevalue(size_t iters, void *arg)
+{
+    sd_bus_message *calls[WRITES];
+    struct config saved = config;
+    struct keyboard *kbd;
+
+    for (size_t i = 0; i < WRITES; i++) {
+        char value[OTP_MAX + 1];
+
+        snprintf(value, sizeof(value), "%s", (const char *) arg);
+        value[0] = '0' + i % 10;
+        value[1] = '0' + i / 10 % 10;
+        calls[i] = new_writevalue(value);
+    }
+
+    config.rate_interval = 0;
+    kbd = harness_keyboard(SINK_FD);
+    config = saved;
+
+    for (size_t i = 0; i < iters; i++) {
+        sd_bus_message *call = calls[i % WRITES];
+        sd_bus_error err = SD_BUS_ERROR_NULL;
+
+        if (sd_bus_message_rewind(call, true) < 0 ||
+            chr_writevalue(call, kbd, &err) < 0)
+            abort();
+
+        harness_pump();
+    }
+
+    for (size_t i = 0; i < WRITES; i++)
+        sd_bus_message_unref(calls[i]);
+}
+
+/* A property and the data its getter reads, as sd-bus would pass it. */
+struct property {
+    const sd_bus_vtable *vtable;
+    void *userdata;
+};
+
+static void
+bench_property(size_t iters, void *arg)
+{
+    const struct property *p = arg;
+    const sd_bus_vtable *v = p->vtable;
+    const char *sig = v->x.property.signature;
+    sd_bus_message *m = NULL;
+
+    /* Amortize message allocation over many Gets. */
+    for (size_t i = 0; i < iters; i++) {
+        sd_bus_error err = SD_BUS_ERROR_NULL;
+
+        if (i % 256 == 0) {
+            sd_bus_message_unref(m);
+            if (sd_bus_message_new_method_call(
+                    harness_bus(), &m, NULL, "/",
+                    "org.freedesktop.DBus.Properties", "Get") < 0)
+                abort();
+        }
+
+        if (sd_bus_message_open_container(m, 'v', sig) < 0 ||
+            v->x.property.get(harness_bus(), "/", "", v->x.property.member,
+                              m, p->userdata, &err) < 0 ||
+            sd_bus_message_close_container(m) < 0)
+            abort();
+    }
+
+    sd_bus_message_unref(m);
+}
+
+static int
+append_device(sd_bus_message *m, size_t i)
+{
+    char path[sizeof(OBJECTS_PATH)];
+    char addr[sizeof("00:11:22:33:44:55")];
+
+    snprintf(path, sizeof(path), OBJECTS_PATH, (uint8_t) (i >> 8), (uint8_t) i);
+    snprintf(addr, sizeof(addr), "00:11:22:33:44:%02X", (uint8_t) i);
+
+    return sd_bus_message_append(
+        m, "{oa{sa{sv}}}", path, 2,
+        "org.freedesktop.DBus.Introspectable", 0,
+        "org.bluez.Device1", 12,
+            "Address", "s", addr,
+            "AddressType", "s", "random",
+            "Name", "s", "Phone",
+            "Alias", "s", "Phone",
+            "Appearance", "q", 0x40,
+            "Icon", "s", "phone",
+            "Paired", "b", true,
+            "Trusted", "b", false,
+            "Connected", "b", false,
+            "UUIDs", "as", 2, SVC_UUID, "00001800-0000-1000-8000-00805f9b34fb",
+            "Adapter", "o", "/org/bluez/hci0",
+            "ServicesResolved", "b", false
+    );
+}
+
+static void
+bench_objects(size_t iters, void *arg)
+{
+    SCOPED(sd_bus_message) *m = NULL;
+    size_t count = (uintptr_t) arg;
+
+    if (sd_bus_message_new_method_call(harness_bus(), &m, NULL, "/",
+                                       "org.freedesktop.DBus.ObjectManager",
+                                       "GetManagedObjects") < 0 ||
+        sd_bus_message_open_container(m, 'a', "{oa{sa{sv}}}") < 0 ||
+        sd_bus_message_append(m, "{oa{sa{sv}}}", "/org/bluez/hci0", 1,
+                              "org.bluez.Adapter1", 2,
+                              "Address", "s", "00:11:22:33:44:55",
+                              "Powered", "b", true) < 0)
+        abort();
+
+    for (size_t i = 0; i < count; i++) {
+        if (append_device(m, i) < 0)
+            abort();
+    }
+
+    if (sd_bus_message_close_container(m) < 0 || harness_seal(m) < 0)
+        abort();
+
+    for (size_t i = 0; i < iters; i++) {
+        if (sd_bus_message_rewind(m, true) < 0 ||
+            on_bt_objects(m, harness_bus(), NULL) < 0)
+            abort();
+    }
+}
+
+static void
+run_properties(const char *prefix, const sd_bus_vtable *vtable,
+               const void *data)
+{
+    for (const sd_bus_vtable *v = vtable; v->type != _SD_BUS_VTABLE_END; v++) {
+        struct property p = { v, NULL };
+        char name[64];
+
+        if (v->type != _SD_BUS_VTABLE_PROPERTY &&
+            v->type != _SD_BUS_VTABLE_WRITABLE_PROPERTY)
+            continue;
+
+        if (data)
+            p.userdata = (uint8_t *) data + v->x.property.offset;
+
+        snprintf(name, sizeof(name), "props/%s/%s",
+                 prefix, v->x.property.member);
+        run(name, bench_property, &p);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const size_t sizes[] = { 1, 2, 4, 6, 8, 16, 32 };
+    static const size_t objects[] = { 16, 256, 1024 };
+    const char *t = getenv("BENCH_TIME");
+    char name[64];
+
+    if (t && atof(t) > 0)
+        bench_time = atof(t);
+    if (argc > 1)
+        bench_filter = argv[1];
+
+    for (size_t i = 0; i < COUNT(sizes); i++) {
+        snprintf(name, sizeof(name), "validate/%zu", sizes[i]);
+        run(name, bench_validate, (void *) (uintptr_t) sizes[i]);
+    }
+
+    run("frame", bench_frame, NULL);
+    run("reply/return", bench_reply_return, NULL);
+    run("reply/error", bench_reply_error, NULL);
+    run("writevalue/valid", bench_writevalue, "123456");
+    run("writevalue/invalid", bench_writevalue, "12345a");
+
+    run_properties("adv", adv_vtable, NULL);
+    for (const struct gatt_object *o = gatt_objects; o->path; o++)
+        run_properties(strrchr(o->path, '/') + 1, o->vtable, o->data);
+
+    for (size_t i = 0; i < COUNT(objects); i++) {
+        snprintf(name, sizeof(name), "objects/%zu", objects[i]);
+        run(name, bench_objects, (void *) (uintptr_t) objects[i]);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "harness.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Time to discovery. Starts the daemon against the mock bluetoothd with
+ * the given daemon options, reads back the advertising interval it
+ * registered and then simulates a phone scanning for it: the advertiser
+ * sends an event every interval plus the 0-10 ms random delay the spec
+ * adds, the phone listens for WINDOW ms out of every PERIOD ms from a
+ * random phase, and the first event inside a window is a discovery.
+ * Only when no interval is configured does bluez's default of 1.28 s
+ * apply; a configured one that does not reach the mock is a failure. The
+ * defaults match Android's balanced scan mode.
+ *
+ *   discovery [-w WINDOW] [-p PERIOD] [-n TRIALS] [-- DAEMON OPTIONS]
+ */
+
+#define DEFAULT_INTERVAL_MS 1280
+#define GIVE_UP_MS 600000
+
+static uint64_t seed = 0x9e3779b97f4a7c15ULL;
+
+static double
+uniform(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return (seed >> 11) * (1.0 / (1ULL << 53));
+}
+
+static int
+compare(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/* Milliseconds until the first advertising event lands in a scan window. */
+static double
+discover(double interval, double window, double period)
+{
+    double phase = uniform() * period;
+    double t = uniform() * interval;
+
+    for (; t < GIVE_UP_MS; t += interval + uniform() * 10) {
+        double into = t + phase;
+
+        if (into - (uint64_t) (into / period) * period < window)
+            return t;
+    }
+
+    return GIVE_UP_MS;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-w WINDOW_MS] [-p PERIOD_MS] [-n TRIALS] "
+            "[-- DAEMON OPTIONS]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    SCOPED(sd_event) *e = NULL;
+    struct mock_bluez *bluez;
+    struct keyboard kbd;
+    double window = 1024;
+    double period = 4096;
+    uint32_t least;
+    uint32_t want;
+    double interval;
+    double sum = 0;
+    size_t trials = 10000;
+    double *ms;
+    int opt;
+    int r;
+
+    while ((opt = getopt(argc, argv, "w:p:n:")) != -1) {
+        switch (opt) {
+        case 'w': window = atof(optarg); break;
+        case 'p': period = atof(optarg); break;
+        case 'n': trials = strtoul(optarg, NULL, 10); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (window <= 0 || period < window || trials == 0)
+        usage(argv[0]);
+
+    /* What follows "--" goes to the daemon, as its own command line. */
+    argv[optind - 1] = argv[0];
+    argc -= optind - 1;
+    argv += optind - 1;
+    optind = 0;
+    setup_config(argc, argv);
+
+    if (sd_event_new(&e) < 0 ||
+        sd_bus_attach_event(harness_bus(), e, 0) < 0 ||
+        sd_bus_attach_event(harness_peer(), e, 0) < 0)
+        abort();
+
+    bluez = harness_bluez();
+    setup_daemon(harness_bus(), e, &kbd);
+
+    for (size_t i = 0; (r = sd_event_run(e, 100000)) > 0; i++) {
+        if (i > 4096)
+            abort();
+    }
+    if (r < 0 || bluez->advertisements != 1 || !bluez->advertisement.read) {
+        fprintf(stderr, "Advertisement was not registered\n");
+        return EXIT_FAILURE;
+    }
+
+    /* A burst is under way at startup, if bursts are on. */
+    least = config.adv_min_interval;
+    want = config.adv_max_interval;
+    if (config.adv_burst_usec > 0) {
+        least = config.adv_burst_min;
+        want = config.adv_burst_max;
+    }
+
+    if (bluez->advertisement.min_interval != least ||
+        bluez->advertisement.max_interval != want) {
+        fprintf(stderr, "Registered interval %u-%u ms, expected %u-%u ms\n",
+                bluez->advertisement.min_interval,
+                bluez->advertisement.max_interval, least, want);
+        return EXIT_FAILURE;
+    }
+
+    interval = want > 0 ? want : DEFAULT_INTERVAL_MS;
+
+    ms = calloc(trials, sizeof(*ms));
+    if (!ms)
+        abort();
+
+    for (size_t i = 0; i < trials; i++) {
+        ms[i] = discover(interval, window, period);
+        sum += ms[i];
+    }
+    qsort(ms, trials, sizeof(*ms), compare);
+
+    printf("{\"metric\": \"discovery_ms\", \"interval_ms\": %.0f, "
+           "\"window_ms\": %.0f, \"period_ms\": %.0f, \"trials\": %zu, "
+           "\"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, "
+           "\"max\": %.1f, \"registered_ms\": %.3f}\n", interval, window,
+           period, trials, sum / trials, ms[trials / 2],
+           ms[trials * 9 / 10], ms[trials * 99 / 100], ms[trials - 1],
+           (bluez->advertisement_usec - bluez->started) / 1000.0);
+
+    free(ms);
+    keyboard_cleanup(&kbd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,224 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+ * Compares the two ways of typing a code: an event() write followed by a
+ * sleep for every key transition, and type_uring(), which submits the
+ * whole code as one linked io_uring chain. Both type the same codes into a
+ * pipe. A reader thread timestamps every key event, so jitter is how far
+ * each gap between transitions strays from the 50 ms pacing; CPU time is
+ * that of the typing thread alone.
+ *
+ *   engines [codes]
+ */
+
+#define CODE "123456"
+#define TRANSITIONS (2 * (sizeof(CODE) - 1 + 1))
+
+static int sink[2] = { -1, -1 };
+static uint64_t *stamps;
+static atomic_size_t nstamps;
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t
+cpu_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *
+reader_main(void *arg)
+{
+    struct input_event ev;
+
+    while (read(sink[0], &ev, sizeof(ev)) == sizeof(ev)) {
+        if (ev.type == EV_KEY)
+            stamps[atomic_fetch_add(&nstamps, 1)] = now_ns();
+    }
+
+    return NULL;
+}
+
+static int
+stroke(uinput input, uint16_t k, bool down)
+{
+    int r;
+
+    r = event(input, k, down);
+    if (r >= 0)
+        usleep(PACE_USEC);
+
+    return r;
+}
+
+/* What keyboard.c does without io_uring. */
+static int
+type_event(uinput input, const uint8_t *bytes, size_t size)
+{
+    int r = 0;
+
+    for (size_t i = 0; i <= size && r >= 0; i++) {
+        uint16_t k = i < size ? char2key(bytes[i]) : KEY_ENTER;
+
+        r = stroke(input, k, true);
+        if (r >= 0)
+            r = stroke(input, k, false);
+    }
+    if (r >= 0)
+        r = stroke(input, KEY_UNKNOWN, false);
+
+    return r;
+}
+
+/* What keyboard.c does with io_uring, waiting for the chain to end. */
+static int
+type_uring(uinput input, const uint8_t *bytes, size_t size)
+{
+    struct pollfd pfd = { .fd = uring_fd(), .events = POLLIN };
+    int r;
+
+    r = uring_submit(input, bytes, size, true);
+    while (r >= 0 && (r = uring_reap()) == -EAGAIN) {
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+            return -errno;
+    }
+
+    return r;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    const double *x = a;
+    const double *y = b;
+
+    return (*x > *y) - (*x < *y);
+}
+
+static double
+percentile(const double *sorted, size_t n, double p)
+{
+    size_t rank = ceil(p * n);
+
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void
+run(const char *name, int (*type)(uinput, const uint8_t *, size_t),
+    size_t codes)
+{
+    size_t first = atomic_load(&nstamps);
+    size_t ngaps = codes * (TRANSITIONS - 1);
+    double *us = calloc(ngaps, sizeof(*us));
+    uint64_t cpu = cpu_ns();
+    uint64_t wall = now_ns();
+    double sum = 0;
+
+    if (!us)
+        abort();
+
+    for (size_t i = 0; i < codes; i++) {
+        if (type(sink[1], (const uint8_t *) CODE, sizeof(CODE) - 1) < 0) {
+            fprintf(stderr, "%s: typing failed\n", name);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    cpu = cpu_ns() - cpu;
+    wall = now_ns() - wall;
+
+    while (atomic_load(&nstamps) < first + codes * TRANSITIONS)
+        usleep(1000);
+
+    /* Only gaps within a code: the pause between codes is not paced. */
+    for (size_t i = 0, g = 0; i < codes; i++) {
+        const uint64_t *t = &stamps[first + i * TRANSITIONS];
+
+        for (size_t j = 1; j < TRANSITIONS; j++, g++) {
+            us[g] = fabs((double) (t[j] - t[j - 1]) - PACE_USEC * 1000) / 1000;
+            sum += us[g];
+        }
+    }
+
+    qsort(us, ngaps, sizeof(*us), cmp_double);
+    printf("{\"engine\": \"%s\", \"codes\": %zu, "
+           "\"cpu_us_per_code\": %.1f, \"wall_ms_per_code\": %.1f, "
+           "\"jitter_us\": {\"mean\": %.1f, \"p50\": %.1f, \"p99\": %.1f, "
+           "\"max\": %.1f}}\n", name, codes,
+           cpu / 1000.0 / codes, wall / 1000000.0 / codes, sum / ngaps,
+           percentile(us, ngaps, 0.50), percentile(us, ngaps, 0.99),
+           us[ngaps - 1]);
+    free(us);
+}
+
+int
+main(int argc, char *argv[])
+{
+    size_t codes = 10;
+    pthread_t reader;
+
+    if (argc > 1)
+        codes = strtoul(argv[1], NULL, 10);
+    if (codes == 0)
+        codes = 1;
+
+    stamps = calloc(2 * codes * TRANSITIONS, sizeof(*stamps));
+    if (!stamps || pipe(sink) < 0 ||
+        pthread_create(&reader, NULL, reader_main, NULL) != 0)
+        abort();
+
+    /* Warm up the ring (and its feature probe) outside the measurement. */
+    if (type_uring(sink[1], (const uint8_t *) "", 0) < 0) {
+        fprintf(stderr, "io_uring engine unavailable on this kernel\n");
+        return EXIT_FAILURE;
+    }
+    while (atomic_load(&nstamps) < 2)
+        usleep(1000);
+    atomic_store(&nstamps, 0);
+
+    run("event", type_event, codes);
+    run("io_uring", type_uring, codes);
+
+    close(sink[1]);
+    pthread_join(reader, NULL);
+    free(stamps);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "harness.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Idle wakeup budget. Starts the daemon against the mock bluetoothd, lets
+ * registration settle, then counts the loop iterations that do anything
+ * during a quiet window. An idle daemon must not wake up at all, so any
+ * wakeup fails the run; the JSON result says which kind it was.
+ *
+ *   idle [seconds]
+ */
+
+static uint64_t
+now_usec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int
+main(int argc, char *argv[])
+{
+    SCOPED(sd_event) *e = NULL;
+    struct mock_bluez *bluez;
+    struct keyboard kbd;
+    uint64_t wakeups;
+    uint64_t timers;
+    uint64_t end;
+    double window = 3;
+    int r;
+
+    if (argc > 1)
+        window = atof(argv[1]);
+
+    if (sd_event_new(&e) < 0 ||
+        sd_bus_attach_event(harness_bus(), e, 0) < 0 ||
+        sd_bus_attach_event(harness_peer(), e, 0) < 0)
+        abort();
+
+    bluez = harness_bluez();
+    setup_daemon(harness_bus(), e, &kbd);
+
+    /* Settle: run until registration is done and nothing is pending. */
+    for (size_t i = 0; (r = sd_event_run(e, 100000)) > 0; i++) {
+        if (i > 4096)
+            abort();
+    }
+    if (r < 0 || bluez->applications != 1 || bluez->advertisements != 1) {
+        fprintf(stderr, "Registration did not complete\n");
+        return EXIT_FAILURE;
+    }
+
+    wakeups = stats.wakeups;
+    timers = stats.timer_wakeups;
+
+    end = now_usec() + window * 1000000;
+    for (uint64_t t = now_usec(); t < end; t = now_usec()) {
+        r = sd_event_run(e, end - t);
+        if (r < 0)
+            abort();
+    }
+
+    wakeups = stats.wakeups - wakeups;
+    timers = stats.timer_wakeups - timers;
+    printf("{\"metric\": \"idle_wakeups\", \"window_s\": %.1f, "
+           "\"wakeups\": %llu, \"timer_wakeups\": %llu}\n", window,
+           (unsigned long long) wakeups, (unsigned long long) timers);
+
+    keyboard_cleanup(&kbd);
+    return wakeups > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,366 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "harness.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+ * Load generator for the typing path. N simulated phones, each with its
+ * own WriteValue "device" option, issue writes with Poisson arrivals at a
+ * daemon running the real objects and event() in a thread of its own. Key
+ * events are written to a pipe rather than uinput; a reader thread decodes
+ * them, so every request is timed by what actually got typed:
+ *
+ *   queueing:   arrival -> first key down
+ *   service:    first key down -> Enter released
+ *   completion: arrival -> Enter released
+ *   ack:        arrival -> WriteValue reply
+ *
+ * Each payload is the zero-padded request number, which is how typed codes
+ * are matched back to their requests. Results are printed as one JSON
+ * object per metric.
+ */
+
+#define DEVICE_PATH "/org/bluez/hci0/dev_02_00_00_00_%02X_%02X"
+
+enum { ARRIVED, ACKED, STARTED, TYPED, PHASES };
+
+struct request {
+    uint64_t t[PHASES];
+    unsigned phone;
+    bool failed;
+};
+
+static struct request *requests;
+static size_t nrequests;
+static size_t ndigits = 6;
+
+static atomic_size_t typed;
+static atomic_bool done;
+static int sink[2] = { -1, -1 };
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *
+daemon_main(void *arg)
+{
+    SCOPED(sd_event) *e = NULL;
+    struct keyboard kbd;
+    sd_bus *bus = arg;
+
+    if (sd_event_new(&e) < 0 || sd_bus_attach_event(bus, e, 0) < 0)
+        abort();
+
+    keyboard_attach(&kbd, e, sink[1]);
+    setup_objects(bus, &kbd);
+
+    while (!atomic_load(&done)) {
+        int r = sd_event_run(e, 100000);
+        if (r < 0 && r != -EINTR)
+            abort();
+    }
+
+    kbd.fd = -1;
+    keyboard_cleanup(&kbd);
+    sd_bus_detach_event(bus);
+    return NULL;
+}
+
+static char
+key2char(uint16_t k)
+{
+    for (char c = '0'; c <= '9'; c++) {
+        if (char2key(c) == k)
+            return c;
+    }
+
+    return '\0';
+}
+
+static void *
+reader_main(void *arg)
+{
+    char digits[32] = {};
+    uint64_t start = 0;
+    size_t n = 0;
+    struct input_event ev;
+
+    while (read(sink[0], &ev, sizeof(ev)) == sizeof(ev)) {
+        size_t id;
+        char c;
+
+        if (ev.type != EV_KEY)
+            continue;
+
+        if (ev.value == 1 && start == 0)
+            start = now_ns();
+
+        if (ev.value != 0)
+            continue;
+
+        if (ev.code != KEY_ENTER) {
+            c = key2char(ev.code);
+            if (c && n < sizeof(digits) - 1)
+                digits[n++] = c;
+            continue;
+        }
+
+        digits[n] = '\0';
+        id = strtoul(digits, NULL, 10);
+        if (n == ndigits && id < nrequests) {
+            requests[id].t[STARTED] = start;
+            requests[id].t[TYPED] = now_ns();
+            atomic_fetch_add(&typed, 1);
+        }
+
+        start = 0;
+        n = 0;
+    }
+
+    return NULL;
+}
+
+static int
+on_ack(sd_bus_message *m, void *userdata, sd_bus_error *ret_error)
+{
+    struct request *req = userdata;
+
+    req->t[ACKED] = now_ns();
+    req->failed = sd_bus_message_is_method_error(m, NULL);
+    return 0;
+}
+
+static void
+send_write(sd_bus *bus, size_t id)
+{
+    SCOPED(sd_bus_message) *m = NULL;
+    struct request *req = &requests[id];
+    char path[sizeof(DEVICE_PATH)];
+    char value[32];
+
+    snprintf(path, sizeof(path), DEVICE_PATH,
+             (uint8_t) (req->phone >> 8), (uint8_t) req->phone);
+    snprintf(value, sizeof(value), "%0*zu", (int) ndigits, id);
+
+    if (sd_bus_message_new_method_call(bus, &m, NULL, CHR_PATH,
+                                       "org.bluez.GattCharacteristic1",
+                                       "WriteValue") < 0 ||
+        sd_bus_message_append_array(m, 'y', value, ndigits) < 0 ||
+        sd_bus_message_append(m, "a{sv}", 1, "device", "o", path) < 0 ||
+        sd_bus_call_async(bus, NULL, m, on_ack, req, UINT64_MAX) < 0)
+        abort();
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    const double *x = a;
+    const double *y = b;
+
+    return (*x > *y) - (*x < *y);
+}
+
+static double
+percentile(const double *sorted, size_t n, double p)
+{
+    size_t rank = ceil(p * n);
+
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void
+report(const char *metric, int from, int to)
+{
+    double *ms = calloc(nrequests, sizeof(*ms));
+    double sum = 0;
+    size_t n = 0;
+
+    if (!ms)
+        abort();
+
+    for (size_t i = 0; i < nrequests; i++) {
+        const uint64_t *t = requests[i].t;
+
+        if (t[TYPED] == 0 || t[from] == 0 || t[to] == 0)
+            continue;
+
+        ms[n] = (t[to] - t[from]) / 1e6;
+        sum += ms[n++];
+    }
+
+    if (n > 0) {
+        qsort(ms, n, sizeof(*ms), cmp_double);
+        printf("{\"metric\": \"%s_ms\", \"count\": %zu, \"mean\": %.3f, "
+               "\"p50\": %.3f, \"p99\": %.3f, \"p999\": %.3f, "
+               "\"max\": %.3f}\n", metric, n, sum / n,
+               percentile(ms, n, 0.50), percentile(ms, n, 0.99),
+               percentile(ms, n, 0.999), ms[n - 1]);
+    }
+
+    free(ms);
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-p PHONES] [-w WRITES] [-i SECONDS] [-d DIGITS] "
+            "[-s SEED] [-q DEPTH] [-f POLICY]\n"
+            "  -p  simulated phones (default 4)\n"
+            "  -w  total writes (default 40)\n"
+            "  -i  mean seconds between writes of one phone (default 5)\n"
+            "  -d  digits per code (default 6)\n"
+            "  -s  random seed (default 1)\n"
+            "  -q  daemon queue depth (default %zu)\n"
+            "  -f  daemon queue full policy: reject, drop-oldest or block "
+            "(default block)\n", prog, config.queue_depth);
+    exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    pthread_t daemon_thread;
+    pthread_t reader_thread;
+    unsigned phones = 4;
+    double interval = 5;
+    size_t dropped = 0;
+    size_t acked = 0;
+    size_t failed = 0;
+    size_t next = 0;
+    long seed = 1;
+    uint64_t start;
+    uint64_t t = 0;
+    sd_bus *bus;
+    int opt;
+
+    nrequests = 40;
+    while ((opt = getopt(argc, argv, "p:w:i:d:s:q:f:")) != -1) {
+        switch (opt) {
+        case 'p': phones = strtoul(optarg, NULL, 10); break;
+        case 'w': nrequests = strtoul(optarg, NULL, 10); break;
+        case 'i': interval = strtod(optarg, NULL); break;
+        case 'd': ndigits = strtoul(optarg, NULL, 10); break;
+        case 's': seed = strtol(optarg, NULL, 10); break;
+        case 'q': config.queue_depth = strtoul(optarg, NULL, 10); break;
+        case 'f':
+            if (strcmp(optarg, "reject") == 0)
+                config.queue_full = QUEUE_FULL_REJECT;
+            else if (strcmp(optarg, "drop-oldest") == 0)
+                config.queue_full = QUEUE_FULL_DROP_OLDEST;
+            else if (strcmp(optarg, "block") == 0)
+                config.queue_full = QUEUE_FULL_BLOCK;
+            else
+                usage(argv[0]);
+            break;
+        default: usage(argv[0]);
+        }
+    }
+    if (phones == 0 || nrequests == 0 || interval <= 0 ||
+        ndigits == 0 || ndigits > 16 ||
+        config.queue_depth == 0 || config.queue_depth > PENDING_MAX)
+        usage(argv[0]);
+
+    requests = calloc(nrequests, sizeof(*requests));
+    if (!requests || pipe(sink) < 0)
+        abort();
+
+    /*
+     * N independent Poisson streams merge into one with N times the rate,
+     * each arrival belonging to a uniformly chosen phone.
+     */
+    srand48(seed);
+    for (size_t i = 0; i < nrequests; i++) {
+        t += -log(1 - drand48()) * interval / phones * 1e9;
+        requests[i].t[ARRIVED] = t;
+        requests[i].phone = lrand48() % phones;
+    }
+
+    bus = harness_bus();
+    if (pthread_create(&daemon_thread, NULL, daemon_main, harness_peer()) ||
+        pthread_create(&reader_thread, NULL, reader_main, NULL))
+        abort();
+
+    start = now_ns();
+    for (size_t i = 0; i < nrequests; i++)
+        requests[i].t[ARRIVED] += start;
+
+    /* Dropped codes were acknowledged but will never be typed. */
+    while (acked < nrequests ||
+           atomic_load(&typed) + failed + dropped < nrequests) {
+        uint64_t timeout = 100000;
+        int r;
+
+        for (t = now_ns(); next < nrequests && requests[next].t[ARRIVED] <= t; )
+            send_write(bus, next++);
+
+        r = sd_bus_process(bus, NULL);
+        if (r < 0)
+            abort();
+        dropped = __atomic_load_n(&stats.queue_dropped, __ATOMIC_RELAXED);
+        if (r > 0) {
+            acked = failed = 0;
+            for (size_t i = 0; i < next; i++) {
+                acked += requests[i].t[ACKED] != 0;
+                failed += requests[i].failed;
+            }
+            continue;
+        }
+
+        if (next < nrequests)
+            timeout = (requests[next].t[ARRIVED] - t) / 1000 + 1;
+
+        r = sd_bus_wait(bus, timeout);
+        if (r < 0 && r != -EINTR)
+            abort();
+    }
+
+    atomic_store(&done, true);
+    pthread_join(daemon_thread, NULL);
+    close(sink[1]);
+    pthread_join(reader_thread, NULL);
+
+    printf("{\"phones\": %u, \"writes\": %zu, \"typed\": %zu, "
+           "\"failed\": %zu, \"dropped\": %zu, \"offered_per_s\": %.3f}\n",
+           phones, nrequests, atomic_load(&typed), failed, dropped,
+           phones / interval);
+
+    report("queueing", ARRIVED, STARTED);
+    report("service", STARTED, TYPED);
+    report("completion", ARRIVED, TYPED);
+    report("ack", ARRIVED, ACKED);
+
+    return EXIT_SUCCESS;
+}
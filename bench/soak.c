@@ -0,0 +1,763 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "harness.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <errno.h>
+#include <unistd.h>
+
+/*
+ * Soak and timing checks for the typing path on the virtual clock (see
+ * harness/vclock.c), so the 50 ms key pacing, uinput recreation backoff
+ * and pending code expiry all run in simulated time:
+ *
+ *   soak:      N random codes typed back to back; every transition must
+ *              be the expected key, exactly PACE_USEC after the previous one
+ *   queue:     each queue full policy with a queue depth of two
+ *   supersede: newer codes from a phone cut short the one being typed and
+ *              drop the queued one
+ *   recovery:  a write fails mid-code and the device takes two retries to
+ *              come back; both codes are then typed in full and in order
+ *   expiry:    the device never comes back; the queued code times out
+ *   capabilities: the capabilities value read whole and from an offset
+ *
+ * This file stands in for uinput.c, recording transitions in memory. It
+ * runs the named checks, or all of them, prints one JSON object per check
+ * and fails if any check does. Each check is also a test of its own.
+ *
+ *   soak [-n CODES] [CHECK...]
+ */
+
+#define TRACE_MAX (2 * (2 * (OTP_MAX + 1) + 1))
+#define CALLS_MAX 64
+
+struct transition {
+    uint64_t at;
+    uint16_t key;
+    bool down;
+};
+
+static struct transition trace[TRACE_MAX];
+static size_t ntrace;
+
+static size_t codes = 100000;
+
+static size_t fail_in;      /* fail the n-th next write; 0 for never */
+static uint64_t failed_at;
+static size_t open_failures;
+static uint64_t opened[16];
+static size_t nopened;
+
+/* Outcome of each call, by cookie: 1 returned, -1 failed. */
+static int outcomes[CALLS_MAX];
+
+/* The value the last ReadValue call returned. */
+static uint8_t readback[32];
+static size_t nreadback;
+
+void
+uinput_cleanup(uinput *i)
+{
+}
+
+int
+uinput_open(uinput *input)
+{
+    if (nopened < COUNT(opened))
+        opened[nopened++] = vclock_now();
+
+    if (open_failures > 0) {
+        open_failures--;
+        return -ENODEV;
+    }
+
+    *input = SINK_FD;
+    return 0;
+}
+
+int
+event(uinput input, uint16_t k, bool down)
+{
+    if (fail_in > 0 && --fail_in == 0) {
+        failed_at = vclock_now();
+        return -EIO;
+    }
+
+    if (ntrace == TRACE_MAX)
+        abort();
+
+    trace[ntrace++] = (struct transition) { vclock_now(), k, down };
+    return 0;
+}
+
+#ifdef JELLING_IO_URING
+/* Typing always goes through event() above. */
+int
+uring_fd(void)
+{
+    return -EOPNOTSUPP;
+}
+
+int
+uring_submit(uinput input, const uint8_t *bytes, size_t size, bool enter)
+{
+    return -EOPNOTSUPP;
+}
+
+int
+uring_reap(void)
+{
+    return -EOPNOTSUPP;
+}
+
+int
+uring_cancel(void)
+{
+    return -EOPNOTSUPP;
+}
+#endif
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Checks that trace[from...] is exactly one paced typing of code, ending
+ * with Enter unless it was cut short.
+ */
+static bool
+typed(size_t from, const char *code, bool enter)
+{
+    size_t n = strlen(code);
+    size_t t = 2 * (n + enter) + 1;
+
+    if (ntrace - from < t)
+        return false;
+
+    for (size_t i = 0; i < t; i++) {
+        const struct transition *tr = &trace[from + i];
+        uint16_t k = KEY_UNKNOWN;
+        bool down = false;
+
+        if (i < 2 * (n + enter)) {
+            k = i / 2 < n ? char2key(code[i / 2]) : KEY_ENTER;
+            down = i % 2 == 0;
+        }
+
+        if (tr->key != k || tr->down != down)
+            return false;
+
+        if (i > 0 && tr->at - tr[-1].at != PACE_USEC)
+            return false;
+    }
+
+    return true;
+}
+
+/* Writes digits as a raw value would be written, Enter included. */
+static int
+write_code(struct keyboard *kbd, sd_bus_message *call, const char *device,
+           const char *digits)
+{
+    struct record rec = { (const uint8_t *) digits, strlen(digits), true };
+
+    return keyboard_type(kbd, call, device, &rec, 1);
+}
+
+static int
+on_reply(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    const void *bytes = NULL;
+    size_t size = 0;
+    uint64_t cookie;
+
+    if (sd_bus_message_get_reply_cookie(m, &cookie) >= 0 &&
+        cookie < CALLS_MAX)
+        outcomes[cookie] = sd_bus_message_is_method_error(m, NULL) ? -1 : 1;
+
+    if (sd_bus_message_has_signature(m, "ay") > 0 &&
+        sd_bus_message_read_array(m, 'y', &bytes, &size) >= 0 &&
+        size <= sizeof(readback)) {
+        memcpy(readback, bytes, size);
+        nreadback = size;
+    }
+
+    return 0;
+}
+
+static sd_bus_message *
+call(uint64_t *cookie)
+{
+    sd_bus_message *m = NULL;
+
+    if (sd_bus_message_new_method_call(harness_bus(), &m, NULL, CHR_PATH,
+                                       "org.bluez.GattCharacteristic1",
+                                       "WriteValue") < 0 ||
+        harness_seal(m) < 0 ||
+        sd_bus_message_get_cookie(m, cookie) < 0 ||
+        *cookie >= CALLS_MAX)
+        abort();
+
+    return m;
+}
+
+static bool
+report(const char *check, bool ok)
+{
+    printf("{\"check\": \"%s\", \"ok\": %s}\n", check, ok ? "true" : "false");
+    return ok;
+}
+
+static void
+settle(void)
+{
+    while (vclock_step())
+        continue;
+}
+
+static bool
+soak(void)
+{
+    struct config saved = config;
+    struct keyboard kbd;
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    uint64_t start = vclock_now();
+    uint64_t real = now_ns();
+    size_t keys = 0;
+    bool ok = true;
+
+    /*
+     * Random codes repeat now and then, and come faster than one phone
+     * may send them; they must all be typed here.
+     */
+    config.dedup_window = 0;
+    config.rate_interval = 0;
+    keyboard_init(&kbd, NULL);
+
+    for (size_t i = 0; ok && i < codes; i++) {
+        char code[OTP_MAX + 1] = {};
+        size_t n = 6 + i % 3;
+
+        for (size_t j = 0; j < n; j++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            code[j] = '0' + seed % 10;
+        }
+
+        ntrace = 0;
+        ok = write_code(&kbd, NULL, "", code) == 1;
+        settle();
+        ok = ok && typed(0, code, true) && ntrace == 2 * (n + 1) + 1;
+        keys += ntrace;
+    }
+
+    real = now_ns() - real;
+    printf("{\"check\": \"soak\", \"ok\": %s, \"codes\": %zu, "
+           "\"transitions\": %zu, \"simulated_s\": %.1f, "
+           "\"transitions_per_s\": %.0f}\n", ok ? "true" : "false", codes,
+           keys, (vclock_now() - start) / 1000000.0,
+           keys / (real / 1000000000.0));
+
+    keyboard_cleanup(&kbd);
+    config = saved;
+    return ok;
+}
+
+/* Writes "1", "2", "3" and "4" back to back with a queue depth of two. */
+static bool
+policy(enum queue_full full, const int want[4], const char *expect)
+{
+    struct config saved = config;
+    sd_bus_message *calls[4];
+    uint64_t cookies[4];
+    struct keyboard kbd;
+    bool ok = true;
+    size_t from = 0;
+
+    config.queue_depth = 2;
+    config.queue_full = full;
+    keyboard_init(&kbd, NULL);
+    ntrace = 0;
+
+    /* From four phones, so that none supersedes another. */
+    for (size_t i = 0; i < 4; i++) {
+        char device[] = { 'a' + i, '\0' };
+        char code[] = { '1' + i, '\0' };
+
+        calls[i] = call(&cookies[i]);
+        ok = ok && write_code(&kbd, calls[i], device, code) == want[i];
+    }
+
+    settle();
+    harness_pump();
+
+    /* Blocked writes are answered once their code is accepted. */
+    for (size_t i = 0; i < 4; i++)
+        ok = ok && outcomes[cookies[i]] == (want[i] == 0 ? 1 : 0);
+
+    for (; *expect; expect++, from += 5) {
+        char code[2] = { *expect };
+        ok = ok && typed(from, code, true);
+    }
+
+    keyboard_cleanup(&kbd);
+    for (size_t i = 0; i < 4; i++)
+        sd_bus_message_unref(calls[i]);
+
+    config = saved;
+    return ok && ntrace == from;
+}
+
+static bool
+queue(void)
+{
+    static const int reject[] = { 1, 1, -ENOBUFS, -ENOBUFS };
+    static const int drop[] = { 1, 1, 1, 1 };
+    static const int block[] = { 1, 1, 0, 0 };
+    bool ok;
+
+    stats = (struct stats) {};
+    ok = policy(QUEUE_FULL_REJECT, reject, "12");
+    ok = ok && stats.queue_rejected == 2;
+
+    /* "1" is being typed, so "2" and then "3" make way. */
+    ok = ok && policy(QUEUE_FULL_DROP_OLDEST, drop, "14");
+    ok = ok && stats.queue_dropped == 2;
+
+    ok = ok && policy(QUEUE_FULL_BLOCK, block, "1234");
+    return report("queue", ok);
+}
+
+static bool
+supersede(void)
+{
+    SCOPED(sd_bus_message) *blocked = NULL;
+    struct config saved = config;
+    struct keyboard kbd;
+    uint64_t cookie;
+    bool ok;
+
+    config.queue_depth = 2;
+    keyboard_init(&kbd, NULL);
+    blocked = call(&cookie);
+    stats = (struct stats) {};
+    ntrace = 0;
+
+    /*
+     * "12" from a is on its first key when "56" from a cuts it short and
+     * waits behind "34" from b. "78" from a then drops "56", failing its
+     * write, and takes its place.
+     */
+    ok = write_code(&kbd, NULL, "a", "12") == 1;
+    ok = ok && write_code(&kbd, NULL, "b", "34") == 1;
+    ok = ok && write_code(&kbd, blocked, "a", "56") == 0;
+    ok = ok && write_code(&kbd, NULL, "a", "78") == 0;
+    settle();
+    harness_pump();
+
+    ok = ok && typed(0, "1", false) && typed(3, "34", true) &&
+         typed(12, "78", true) && ntrace == 21;
+    ok = ok && stats.superseded == 2 && outcomes[cookie] == -1;
+    keyboard_cleanup(&kbd);
+
+    /* A write the full queue turns away leaves "12" from a alone. */
+    config.queue_full = QUEUE_FULL_REJECT;
+    keyboard_init(&kbd, NULL);
+    stats = (struct stats) {};
+    ntrace = 0;
+
+    ok = ok && write_code(&kbd, NULL, "a", "12") == 1;
+    ok = ok && write_code(&kbd, NULL, "b", "34") == 1;
+    ok = ok && write_code(&kbd, NULL, "a", "56") == -ENOBUFS;
+    settle();
+
+    ok = ok && typed(0, "12", true) && typed(7, "34", true) &&
+         ntrace == 14 && stats.superseded == 0;
+
+    keyboard_cleanup(&kbd);
+    config = saved;
+    return report("supersede", ok);
+}
+
+static bool
+dedup(void)
+{
+    struct keyboard kbd;
+    bool ok;
+
+    keyboard_init(&kbd, NULL);
+    stats = (struct stats) {};
+    ntrace = 0;
+
+    /* A repeat from a within the window is acknowledged but not typed. */
+    ok = write_code(&kbd, NULL, "a", "12") == 1;
+    settle();
+    ok = ok && write_code(&kbd, NULL, "a", "12") == 1;
+    settle();
+    ok = ok && ntrace == 7 && stats.duplicates_suppressed == 1;
+
+    /* The same code from b, or from a once the window is over, is typed. */
+    ok = ok && write_code(&kbd, NULL, "b", "12") == 1;
+    settle();
+    vclock_advance(config.dedup_window);
+    ok = ok && write_code(&kbd, NULL, "a", "12") == 1;
+    settle();
+    ok = ok && typed(0, "12", true) && typed(7, "12", true) &&
+         typed(14, "12", true) && ntrace == 21;
+    ok = ok && stats.duplicates_suppressed == 1;
+
+    keyboard_cleanup(&kbd);
+    return report("dedup", ok);
+}
+
+static bool
+ratelimit(void)
+{
+    struct config saved = config;
+    struct record many[PENDING_MAX];
+    struct keyboard kbd;
+    bool ok = true;
+
+    for (size_t i = 0; i < PENDING_MAX; i++)
+        many[i] = (struct record) { (const uint8_t *) "1", 1, true };
+
+    config.queue_depth = PENDING_MAX;
+    keyboard_init(&kbd, NULL);
+    stats = (struct stats) {};
+    ntrace = 0;
+
+    /* A burst from a, then one more: the last is turned away at once. */
+    for (size_t i = 0; i < config.rate_burst; i++) {
+        char code[] = { '0' + i, '\0' };
+        ok = ok && write_code(&kbd, NULL, "a", code) == 1;
+    }
+    ok = ok && write_code(&kbd, NULL, "a", "9") == -EBUSY;
+    ok = ok && kbd.count == config.rate_burst && stats.rate_limited == 1;
+
+    /* A batch larger than the burst is too long, not rate limited. */
+    ok = ok && keyboard_type(&kbd, NULL, "c", many, config.rate_burst + 1) ==
+         -EMSGSIZE;
+    ok = ok && stats.rate_limited == 1;
+
+    /* b has a bucket of its own, and a earns a token back in time. */
+    ok = ok && write_code(&kbd, NULL, "b", "9") == 1;
+    settle();
+    vclock_advance(config.rate_interval);
+    ok = ok && write_code(&kbd, NULL, "a", "9") == 1;
+    ok = ok && stats.rate_limited == 1;
+    keyboard_cleanup(&kbd);
+
+    /* Writes a full queue turns away cost d nothing: its burst is whole. */
+    config.queue_depth = 1;
+    config.queue_full = QUEUE_FULL_REJECT;
+    keyboard_init(&kbd, NULL);
+    ok = ok && write_code(&kbd, NULL, "c", "1") == 1;
+    for (size_t i = 0; i <= config.rate_burst; i++)
+        ok = ok && write_code(&kbd, NULL, "d", "2") == -ENOBUFS;
+    settle();
+
+    for (size_t i = 0; i < config.rate_burst; i++) {
+        char code[] = { '0' + i, '\0' };
+        ok = ok && write_code(&kbd, NULL, "d", code) == 1;
+        settle();
+    }
+    ok = ok && stats.rate_limited == 1;
+
+    keyboard_cleanup(&kbd);
+    config = saved;
+    return report("ratelimit", ok);
+}
+
+static bool
+longwrites(void)
+{
+    static const char code[] = "0123456789012345678901234";
+    static const char bad[] = "01234567x";
+    struct write_options opts = { .device = "a", .mtu = 23 };
+    struct keyboard kbd;
+    bool ok;
+
+    keyboard_init(&kbd, NULL);
+    ntrace = 0;
+
+    /* An ordinary write that happens to fill a prepared write: typed now. */
+    ok = longwrite(&kbd, NULL, &opts, (uint8_t *) code, 18) == 1;
+    ok = ok && kbd.count == 1;
+    settle();
+    ok = ok && typed(0, "012345678901234567", true);
+
+    /* A full chunk of 18 is held; the short one after it ends the value. */
+    ntrace = 0;
+    opts.prepared = true;
+    ok = ok && longwrite(&kbd, NULL, &opts, (uint8_t *) code, 18) == 1;
+    opts.offset = 17;
+    ok = ok && longwrite(&kbd, NULL, &opts, (uint8_t *) code, 7) == -EINVAL;
+    ok = ok && ntrace == 0;
+
+    opts.offset = 0;
+    ok = ok && longwrite(&kbd, NULL, &opts, (uint8_t *) code, 18) == 1;
+    opts.offset = 18;
+    ok = ok && longwrite(&kbd, NULL, &opts, (uint8_t *) &code[18], 7) == 1;
+    settle();
+    ok = ok && typed(0, code, true);
+
+    /* Two full chunks of 8: the value ends when no third one follows. */
+    opts = (struct write_options) { .device = "b", .mtu = 13 };
+    opts.prepared = true;
+    ok = ok && longwrite(&kbd, NULL, &opts, (uint8_t *) code, 8) == 1;
+    opts.offset = 8;
+    ok = ok && longwrite(&kbd, NULL, &opts, (uint8_t *) &code[8], 8) == 1;
+    settle();
+    ok = ok && typed(2 * 26 + 1, "0123456789012345", true) &&
+         ntrace == 2 * 26 + 1 + 2 * 17 + 1;
+
+    /* A bad byte fails the chunk that carries it, and nothing is kept. */
+    ntrace = 0;
+    opts.offset = 0;
+    ok = ok && longwrite(&kbd, NULL, &opts, (uint8_t *) bad, 8) == 1;
+    opts.offset = 8;
+    ok = ok && longwrite(&kbd, NULL, &opts, (uint8_t *) &bad[1], 8) ==
+         -EILSEQ;
+    settle();
+    ok = ok && ntrace == 0 && kbd.count == 0;
+
+    keyboard_cleanup(&kbd);
+    return report("longwrite", ok);
+}
+
+static bool
+batch(void)
+{
+    static const uint8_t good[] = {
+        0x01, 0x01, 2, '1', '2', 0x00, 2, '3', '4', 0x01, 1, '5'
+    };
+    static const uint8_t bad[] = {
+        0x01, 0x01, 2, '1', '2', 0x01, 2, '3', 'x'
+    };
+    struct write_options opts = { .device = "a" };
+    struct keyboard kbd;
+    bool ok;
+
+    keyboard_init(&kbd, NULL);
+    ntrace = 0;
+
+    /* One bad code fails the whole batch before anything is typed. */
+    ok = longwrite(&kbd, NULL, &opts, bad, sizeof(bad)) == -EILSEQ;
+    ok = ok && kbd.count == 0;
+
+    ok = ok && longwrite(&kbd, NULL, &opts, good, sizeof(good)) == 1;
+    settle();
+    ok = ok && typed(0, "12", true) && typed(7, "34", false) &&
+         typed(12, "5", true) && ntrace == 17;
+
+    keyboard_cleanup(&kbd);
+    return report("batch", ok);
+}
+
+static bool
+recovery(void)
+{
+    struct keyboard kbd;
+    bool ok;
+
+    keyboard_init(&kbd, NULL);
+    stats = (struct stats) {};
+    ntrace = nopened = 0;
+
+    /* The third transition of "111" fails; two reopens fail after it. */
+    fail_in = 3;
+    open_failures = 2;
+    ok = write_code(&kbd, NULL, "a", "111") == 1;
+    ok = ok && write_code(&kbd, NULL, "b", "222") == 1;
+    settle();
+
+    /* Retries at +0, +200 ms and +600 ms; both codes typed afterwards. */
+    ok = ok && nopened == 3 && opened[0] == failed_at &&
+         opened[1] == failed_at + 200000 && opened[2] == failed_at + 600000;
+    ok = ok && ntrace == 2 + 2 * 9 && typed(2, "111", true) &&
+         typed(11, "222", true);
+    ok = ok && stats.uinput_failures == 1 && stats.uinput_recreations == 1 &&
+         stats.uinput_recreate_last_usec == 600000;
+
+    keyboard_cleanup(&kbd);
+    return report("recovery", ok);
+}
+
+static bool
+expiry(void)
+{
+    struct keyboard kbd;
+    bool ok;
+
+    keyboard_init(&kbd, NULL);
+    stats = (struct stats) {};
+    ntrace = nopened = 0;
+
+    fail_in = 1;
+    open_failures = SIZE_MAX;
+    ok = write_code(&kbd, NULL, "", "333") == 1;
+
+    /* Retries back off to 5 s; the one at 21.2 s expires the code. */
+    vclock_advance(21000000);
+    ok = ok && stats.pending_expired == 0 && kbd.count == 1;
+    vclock_advance(1000000);
+    ok = ok && stats.pending_expired == 1 && kbd.count == 0;
+
+    keyboard_cleanup(&kbd);
+    open_failures = 0;
+    return report("expiry", ok && ntrace == 0);
+}
+
+/* Calls ReadValue on the capabilities characteristic as bluez would. */
+static int
+read_caps(uint16_t offset)
+{
+    SCOPED(sd_bus_message) *m = NULL;
+    const struct gatt_object *o = gatt_objects;
+    const sd_bus_vtable *v;
+    uint64_t cookie;
+
+    while (strcmp(o->path, CAP_PATH) != 0)
+        o++;
+
+    for (v = o->vtable; v->type != _SD_BUS_VTABLE_END; v++) {
+        if (v->type == _SD_BUS_VTABLE_METHOD &&
+            strcmp(v->x.method.member, "ReadValue") == 0)
+            break;
+    }
+
+    if (sd_bus_message_new_method_call(harness_bus(), &m, NULL, CAP_PATH,
+                                       "org.bluez.GattCharacteristic1",
+                                       "ReadValue") < 0 ||
+        sd_bus_message_append(m, "a{sv}", 1, "offset", "q", offset) < 0 ||
+        harness_seal(m) < 0 ||
+        sd_bus_message_get_cookie(m, &cookie) < 0 ||
+        cookie >= CALLS_MAX ||
+        v->x.method.handler(m, (void *) o->data, NULL) < 0)
+        abort();
+
+    nreadback = 0;
+    harness_pump();
+    return outcomes[cookie];
+}
+
+static uint16_t
+le16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static bool
+capabilities(void)
+{
+    struct config saved = config;
+    uint8_t caps[13] = {};
+    bool ok;
+
+    /* One limit under PENDING_MAX and one past what its field holds. */
+    config.queue_depth = 300;
+    config.rate_interval = 60 * 1000000ULL / 30;
+    config.rate_burst = 3;
+    config.supersede = true;
+    config.dedup_window = 0;
+
+    ok = read_caps(0) == 1 && nreadback == sizeof(caps);
+    memcpy(caps, readback, sizeof(caps));
+
+    /* Batch, long write, early ack and supersede; no dedup. */
+    ok = ok && caps[0] == 1 && caps[1] == 0x17;
+    ok = ok && le16(&caps[2]) == VALUE_MAX && caps[4] == 3 &&
+         caps[5] == OTP_MAX && caps[6] == 1 && caps[7] == 255;
+    ok = ok && le16(&caps[8]) == PACE_USEC / 1000 && caps[10] == 3 &&
+         le16(&caps[11]) == 30;
+
+    /* bluez asks for the rest of a long value at an offset. */
+    ok = ok && read_caps(7) == 1 && nreadback == sizeof(caps) - 7 &&
+         memcmp(readback, &caps[7], nreadback) == 0;
+    ok = ok && read_caps(sizeof(caps)) == 1 && nreadback == 0;
+    ok = ok && read_caps(sizeof(caps) + 1) == -1;
+
+    config = saved;
+    return report("capabilities", ok);
+}
+
+static const struct {
+    const char *name;
+    bool (*run)(void);
+} checks[] = {
+    { "soak", soak },
+    { "queue", queue },
+    { "supersede", supersede },
+    { "dedup", dedup },
+    { "ratelimit", ratelimit },
+    { "longwrite", longwrites },
+    { "batch", batch },
+    { "recovery", recovery },
+    { "expiry", expiry },
+    { "capabilities", capabilities },
+};
+
+static bool
+run(const char *name)
+{
+    for (size_t i = 0; i < COUNT(checks); i++) {
+        if (strcmp(checks[i].name, name) == 0)
+            return checks[i].run();
+    }
+
+    fprintf(stderr, "Unknown check: %s\n", name);
+    return false;
+}
+
+int
+main(int argc, char *argv[])
+{
+    bool ok = true;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n': codes = strtoul(optarg, NULL, 10); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n CODES] [CHECK...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    vclock_install();
+    if (sd_bus_add_filter(harness_peer(), NULL, on_reply, NULL) < 0)
+        abort();
+
+    for (int i = optind; i < argc; i++)
+        ok = run(argv[i]) && ok;
+
+    for (size_t i = 0; optind == argc && i < COUNT(checks); i++)
+        ok = checks[i].run() && ok;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
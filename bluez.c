@@ -0,0 +1,307 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Authors: Nathaniel McCallum <npmccallum@redhat.com>
+ *
+ * Copyright (C) 2015  Nathaniel McCallum, Red Hat
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <error.h>
+
+#define MATCH \
+    "type='signal',sender='org.bluez',path='/',member='InterfacesAdded'," \
+    "interface='org.freedesktop.DBus.ObjectManager'"
+
+/*
+ * Adapters the application is registered with. bluez reads the objects,
+ * Handle included, while it registers them, so adapters are registered
+ * one at a time and the Handle they read is chosen for each: the fixed
+ * one, unless bluez could not place it on that adapter before.
+ */
+static struct {
+    char path[DEVICE_MAX];
+    bool waiting;
+    bool chosen; /* Handles are left to bluez. */
+} adapters[ADAPTER_MAX];
+static size_t nadapters;
+static size_t registering = ADAPTER_MAX;
+
+static int
+on_application(sd_bus_message *m, void *misc, sd_bus_error *ret_error);
+
+static int
+register_application(sd_bus *bus, size_t i)
+{
+    int r;
+
+    if (registering < ADAPTER_MAX) {
+        adapters[i].waiting = true;
+        return 0;
+    }
+
+    gatt_fixed_handles(!adapters[i].chosen);
+    r = sd_bus_call_method_async(bus, NULL, "org.bluez", adapters[i].path,
+                                 "org.bluez.GattManager1",
+                                 "RegisterApplication", on_application,
+                                 (void *) (uintptr_t) i, "oa{sv}",
+                                 MAN_PATH, 0);
+    if (r >= 0)
+        registering = i;
+
+    return r;
+}
+
+/* Registers the adapters that waited for their turn. */
+static void
+register_waiting(sd_bus *bus)
+{
+    for (size_t i = 0; i < nadapters && registering == ADAPTER_MAX; i++) {
+        int r;
+
+        if (!adapters[i].waiting)
+            continue;
+
+        adapters[i].waiting = false;
+        r = register_application(bus, i);
+        if (r < 0)
+            fprintf(stderr, "Error registering with %s: %s\n",
+                    adapters[i].path, strerror(-r));
+    }
+}
+
+/* Whether bluez refused the application for want of room at its handles. */
+static bool
+misplaced(const sd_bus_error *error)
+{
+    return sd_bus_error_has_name(error, "org.bluez.Error.Failed") &&
+           error->message && strstr(error->message, "database");
+}
+
+static int
+on_application(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    size_t i = (uintptr_t) misc;
+
+    registering = ADAPTER_MAX;
+
+    if (!sd_bus_error_is_set(ret_error)) {
+        startup_mark(STARTUP_APPLICATION);
+    } else if (sd_bus_error_has_name(ret_error,
+                                     "org.bluez.Error.AlreadyExists")) {
+        /* Seen both in GetManagedObjects and InterfacesAdded: no harm. */
+    } else if (!adapters[i].chosen && misplaced(ret_error)) {
+        /* Phones will have to rediscover us, but they can still find us. */
+        fprintf(stderr, "Error registering with %s: %s: %s\n",
+                adapters[i].path, ret_error->name, ret_error->message);
+        fprintf(stderr, "Registering again with handles chosen by bluez\n");
+        adapters[i].chosen = true;
+        adapters[i].waiting = true;
+    } else {
+        fprintf(stderr, "Error registering with %s: %s: %s\n",
+                adapters[i].path, ret_error->name, ret_error->message);
+    }
+
+    register_waiting(sd_bus_message_get_bus(m));
+    return 0;
+}
+
+/* Whether path is below an adapter the application is registered with. */
+bool
+bluez_registered(const char *path)
+{
+    for (size_t i = 0; i < nadapters; i++) {
+        size_t len = strlen(adapters[i].path);
+
+        if (strncmp(path, adapters[i].path, len) == 0 && path[len] == '/')
+            return true;
+    }
+
+    return false;
+}
+
+static int
+application(sd_bus *bus, const char *adapter)
+{
+    size_t i;
+
+    for (i = 0; i < nadapters; i++) {
+        if (strncmp(adapters[i].path, adapter, DEVICE_MAX - 1) == 0)
+            break;
+    }
+
+    if (i == ADAPTER_MAX) {
+        fprintf(stderr, "Not registering with %s: too many adapters\n",
+                adapter);
+        return 0;
+    }
+
+    if (i == nadapters)
+        snprintf(adapters[nadapters++].path, DEVICE_MAX, "%s", adapter);
+
+    return register_application(bus, i);
+}
+
+/*
+ * Reads one object's interfaces, leaving out devices or everything but
+ * devices as asked: connection.c follows a device only once the adapter
+ * it is on has been registered with.
+ */
+static int
+interfaces(sd_bus_message *m, sd_bus *bus, bool others, bool devices)
+{
+    const char *obj = NULL;
+    int r;
+
+    r = sd_bus_message_has_signature(m, "oa{sa{sv}}");
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_read(m, "o", &obj);
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_enter_container(m, 'a', "{sa{sv}}");
+    if (r < 0)
+        return r;
+
+    while ((r = sd_bus_message_enter_container(m, 'e', "sa{sv}")) > 0) {
+        const char *iface = NULL;
+        bool device;
+        bool wanted;
+
+        r = sd_bus_message_read(m, "s", &iface);
+        if (r < 0)
+            return r;
+
+        device = strcmp(iface, "org.bluez.Device1") == 0;
+        wanted = device ? devices : others;
+
+        if (wanted && strcmp(iface, "org.bluez.LEAdvertisingManager1") == 0)
+            r = advertising_check(m);
+        else if (wanted && device)
+            r = connection_check(m, obj);
+        else
+            r = sd_bus_message_skip(m, "a{sv}");
+        if (r < 0)
+            return r;
+
+        r = sd_bus_message_exit_container(m);
+        if (r < 0)
+            return r;
+
+        if (!wanted)
+            continue;
+
+        if (strcmp(iface, "org.bluez.GattManager1") == 0) {
+            r = application(bus, obj);
+            if (r < 0)
+                return r;
+        }
+
+        if (strcmp(iface, "org.bluez.LEAdvertisingManager1") == 0)
+            advertising_add(bus, obj);
+    }
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_exit_container(m);
+    if (r < 0)
+        return r;
+
+    return 0;
+}
+
+int
+on_bt_iface(sd_bus_message *m, void *bus, sd_bus_error *ret_error)
+{
+    return interfaces(m, bus, true, true);
+}
+
+/* Devices go last, as they may come before their adapter. */
+int
+on_bt_objects(sd_bus_message *m, void *bus, sd_bus_error *ret_error)
+{
+    int r;
+
+    r = sd_bus_message_enter_container(m, 'a', "{oa{sa{sv}}}");
+    if (r < 0)
+        return r;
+
+    for (int pass = 0; pass < 2; pass++) {
+        while ((r = sd_bus_message_enter_container(m, 'e',
+                                                   "oa{sa{sv}}")) > 0) {
+            r = interfaces(m, bus, pass == 0, pass == 1);
+            if (r < 0)
+                return r;
+
+            r = sd_bus_message_exit_container(m);
+            if (r < 0)
+                return r;
+        }
+        if (r >= 0 && pass == 0)
+            r = sd_bus_message_rewind(m, false);
+        if (r < 0)
+            return r;
+    }
+
+    return sd_bus_message_exit_container(m);
+}
+
+static int
+on_managed_objects(sd_bus_message *m, void *bus, sd_bus_error *ret_error)
+{
+    int r;
+
+    if (sd_bus_error_is_set(ret_error)) {
+        error(EXIT_FAILURE, sd_bus_error_get_errno(ret_error),
+              "Error calling bluez ObjectManager");
+    }
+
+    r = on_bt_objects(m, bus, NULL);
+    if (r < 0)
+        error(EXIT_FAILURE, -r, "Error parsing bluez results");
+
+    startup_mark(STARTUP_ADAPTERS);
+    return 0;
+}
+
+/*
+ * Neither call waits for its reply: the adapters are registered from the
+ * main loop, so the caller can create uinput while bluez answers.
+ */
+void
+setup_registration(sd_bus *bus)
+{
+    int r;
+
+    r = sd_bus_add_match_async(bus, NULL, MATCH, on_bt_iface, NULL, bus);
+    if (r < 0)
+        error(EXIT_FAILURE, -r, "Error registering for bluetooth interfaces");
+
+    r = sd_bus_call_method_async(bus, NULL, "org.bluez", "/",
+                                 "org.freedesktop.DBus.ObjectManager",
+                                 "GetManagedObjects", on_managed_objects,
+                                 bus, "");
+    if (r < 0)
+        error(EXIT_FAILURE, -r, "Error calling bluez ObjectManager");
+
+    startup_mark(STARTUP_QUERY);
+}
@@ -0,0 +1,346 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <error.h>
+#include <getopt.h>
+
+struct config config = {
+    .queue_depth = PENDING_MAX / 2,
+    .queue_full = QUEUE_FULL_BLOCK,
+    .supersede = true,
+    .dedup_window = 5 * 1000000ULL,
+    .rate_interval = 60 * 1000000ULL / 30,
+    .rate_burst = 5,
+    .adv_tx_power = ADV_TX_POWER_UNSET,
+    .adv_burst_min = 100,
+    .adv_burst_max = 150,
+    .adv_burst_usec = 30 * 1000000ULL,
+    .adv_tag = true,
+    .seat = "seat0",
+    .adv_when = ADV_WHEN_ALWAYS,
+};
+
+/* Options without a short form. */
+enum {
+    OPT_ADV_INTERVAL = 256,
+    OPT_ADV_TX_POWER,
+    OPT_ADV_DURATION,
+    OPT_ADV_TIMEOUT,
+    OPT_ADV_SECONDARY,
+    OPT_ADV_BURST,
+    OPT_ADV_BURST_TIME,
+    OPT_ADV_TAG,
+    OPT_SEAT,
+    OPT_ADV_WHEN,
+    OPT_DISCONNECT,
+    OPT_CONNECTION_SLOTS,
+    OPT_LOW_LATENCY,
+};
+
+static const char *full_policies[] = {
+    [QUEUE_FULL_REJECT] = "reject",
+    [QUEUE_FULL_DROP_OLDEST] = "drop-oldest",
+    [QUEUE_FULL_BLOCK] = "block",
+};
+
+static const char *switches[] = { "no", "yes" };
+
+static const char *whens[] = {
+    [ADV_WHEN_ALWAYS] = "always",
+    [ADV_WHEN_UNLOCKED] = "unlocked",
+    [ADV_WHEN_PRESENT] = "present",
+};
+
+static const char *channels[] = { "1M", "2M", "Coded" };
+
+static void
+usage(const char *prog, int status)
+{
+    fprintf(status == EXIT_SUCCESS ? stdout : stderr,
+            "Usage: %s [OPTIONS]\n"
+            "  -q, --queue-depth=N       codes accepted ahead of typing "
+            "(1-%d, default %d)\n"
+            "  -f, --queue-full=POLICY   when the queue is full: reject, "
+            "drop-oldest\n"
+            "                            or block (default block)\n"
+            "  -s, --supersede=yes|no    let a newer code from a device "
+            "cancel its\n"
+            "                            older ones (default yes)\n"
+            "  -d, --dedup-window=SECS   acknowledge repeats of a write "
+            "without\n"
+            "                            typing them (0 disables, "
+            "default 5)\n"
+            "  -r, --rate-limit=N        codes per minute from one device "
+            "(0 disables,\n"
+            "                            default 30)\n"
+            "  -b, --rate-burst=N        codes one device may send at once "
+            "(1-60,\n"
+            "                            default 5)\n"
+            "      --adv-interval=MIN[-MAX]\n"
+            "                            advertising interval in ms "
+            "(20-10240)\n"
+            "      --adv-burst=MIN[-MAX] advertising interval while "
+            "bursting\n"
+            "                            (default 100-150)\n"
+            "      --adv-burst-time=SECS how long to advertise fast after "
+            "startup,\n"
+            "                            resume or unlock (0 disables, "
+            "default 30)\n"
+            "      --adv-tx-power=DBM    advertising TX power (-127 to 20)\n"
+            "      --adv-duration=SECS   advertising time slice when "
+            "bluez rotates\n"
+            "                            several advertisements\n"
+            "      --adv-timeout=SECS    stop advertising after SECS\n"
+            "      --adv-secondary=PHY   secondary channel: 1M, 2M or "
+            "Coded\n"
+            "                            (advertising options left out are "
+            "up to bluez)\n"
+            "      --adv-tag=yes|no      advertise a tag identifying this "
+            "host and\n"
+            "                            seat (default yes)\n"
+            "      --seat=NAME           seat the tag names (default seat0)\n"
+            "      --adv-when=WHEN       advertise always, while the seat's "
+            "graphical\n"
+            "                            session is unlocked, or while it is "
+            "also\n"
+            "                            present, i.e. not idle (default "
+            "always)\n"
+            "      --disconnect=yes|no   disconnect a phone once its codes "
+            "are typed\n"
+            "                            (default no)\n"
+            "      --connection-slots=N  connections the controller can "
+            "hold, to count\n"
+            "                            when they run out (0 if unknown, "
+            "the default)\n"
+            "      --low-latency=MIN[-MAX]\n"
+            "                            connection interval in ms for "
+            "bonded phones\n"
+            "                            until their codes are typed "
+            "(8-4000)\n"
+            "  -h, --help                show this help\n",
+            prog, PENDING_MAX, PENDING_MAX / 2);
+    exit(status);
+}
+
+static unsigned long
+number(const char *arg, const char *what, unsigned long min, unsigned long max)
+{
+    unsigned long n;
+    char *end;
+
+    errno = 0;
+    n = strtoul(arg, &end, 10);
+    if (errno != 0 || *arg == '\0' || *end != '\0' || n < min || n > max)
+        error(EXIT_FAILURE, 0, "Invalid %s: %s", what, arg);
+
+    return n;
+}
+
+static long
+integer(const char *arg, const char *what, long min, long max)
+{
+    char *end;
+    long n;
+
+    errno = 0;
+    n = strtol(arg, &end, 10);
+    if (errno != 0 || *arg == '\0' || *end != '\0' || n < min || n > max)
+        error(EXIT_FAILURE, 0, "Invalid %s: %s", what, arg);
+
+    return n;
+}
+
+/* Parses MIN[-MAX] in milliseconds, within the range the spec allows. */
+static void
+interval(const char *arg, const char *what, unsigned long lo,
+         unsigned long hi, uint32_t *min, uint32_t *max)
+{
+    const char *dash = strchr(arg, '-');
+    char first[16] = {};
+
+    if (!dash) {
+        *min = *max = number(arg, what, lo, hi);
+        return;
+    }
+
+    if ((size_t) (dash - arg) >= sizeof(first))
+        error(EXIT_FAILURE, 0, "Invalid %s: %s", what, arg);
+
+    memcpy(first, arg, dash - arg);
+    *min = number(first, what, lo, hi);
+    *max = number(dash + 1, what, *min, hi);
+}
+
+static size_t
+lookup(const char *arg, const char *what, const char *const *names, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (names[i] && strcmp(arg, names[i]) == 0)
+            return i;
+    }
+
+    error(EXIT_FAILURE, 0, "Invalid %s: %s", what, arg);
+    return 0;
+}
+
+void
+setup_config(int argc, char *argv[])
+{
+    static const struct option options[] = {
+        { "queue-depth", required_argument, NULL, 'q' },
+        { "queue-full", required_argument, NULL, 'f' },
+        { "supersede", required_argument, NULL, 's' },
+        { "dedup-window", required_argument, NULL, 'd' },
+        { "rate-limit", required_argument, NULL, 'r' },
+        { "rate-burst", required_argument, NULL, 'b' },
+        { "adv-interval", required_argument, NULL, OPT_ADV_INTERVAL },
+        { "adv-tx-power", required_argument, NULL, OPT_ADV_TX_POWER },
+        { "adv-duration", required_argument, NULL, OPT_ADV_DURATION },
+        { "adv-timeout", required_argument, NULL, OPT_ADV_TIMEOUT },
+        { "adv-secondary", required_argument, NULL, OPT_ADV_SECONDARY },
+        { "adv-burst", required_argument, NULL, OPT_ADV_BURST },
+        { "adv-burst-time", required_argument, NULL, OPT_ADV_BURST_TIME },
+        { "adv-tag", required_argument, NULL, OPT_ADV_TAG },
+        { "seat", required_argument, NULL, OPT_SEAT },
+        { "adv-when", required_argument, NULL, OPT_ADV_WHEN },
+        { "disconnect", required_argument, NULL, OPT_DISCONNECT },
+        { "connection-slots", required_argument, NULL,
+          OPT_CONNECTION_SLOTS },
+        { "low-latency", required_argument, NULL, OPT_LOW_LATENCY },
+        { "help", no_argument, NULL, 'h' },
+        {}
+    };
+    unsigned long rate;
+
+    for (int opt; (opt = getopt_long(argc, argv, "q:f:s:d:r:b:h", options,
+                                     NULL)) != -1; ) {
+        switch (opt) {
+        case 'q':
+            config.queue_depth = number(optarg, "queue depth", 1,
+                                        PENDING_MAX);
+            break;
+
+        case 'f':
+            config.queue_full = lookup(optarg, "queue full policy",
+                                       full_policies,
+                                       COUNT(full_policies));
+            break;
+
+        case 's':
+            config.supersede = lookup(optarg, "supersede setting", switches,
+                                      COUNT(switches));
+            break;
+
+        case 'd':
+            config.dedup_window = number(optarg, "dedup window", 0, 3600)
+                                  * 1000000ULL;
+            break;
+
+        case 'r':
+            rate = number(optarg, "rate limit", 0, 6000);
+            config.rate_interval = rate ? 60 * 1000000ULL / rate : 0;
+            break;
+
+        case 'b':
+            config.rate_burst = number(optarg, "rate burst", 1, 60);
+            break;
+
+        case OPT_ADV_INTERVAL:
+            interval(optarg, "advertising interval", 20, 10240,
+                     &config.adv_min_interval, &config.adv_max_interval);
+            break;
+
+        case OPT_ADV_BURST:
+            interval(optarg, "advertising interval", 20, 10240,
+                     &config.adv_burst_min, &config.adv_burst_max);
+            break;
+
+        case OPT_ADV_BURST_TIME:
+            config.adv_burst_usec = number(optarg, "burst time", 0, 3600)
+                                    * 1000000ULL;
+            break;
+
+        case OPT_ADV_TX_POWER:
+            config.adv_tx_power = integer(optarg, "advertising TX power",
+                                          -127, 20);
+            break;
+
+        case OPT_ADV_DURATION:
+            config.adv_duration = number(optarg, "advertising duration", 1,
+                                         UINT16_MAX);
+            break;
+
+        case OPT_ADV_TIMEOUT:
+            config.adv_timeout = number(optarg, "advertising timeout", 1,
+                                        UINT16_MAX);
+            break;
+
+        case OPT_ADV_SECONDARY:
+            config.adv_secondary = channels[lookup(optarg, "secondary channel",
+                                                   channels,
+                                                   COUNT(channels))];
+            break;
+
+        case OPT_ADV_TAG:
+            config.adv_tag = lookup(optarg, "tag setting", switches,
+                                    COUNT(switches));
+            break;
+
+        case OPT_SEAT:
+            if (*optarg == '\0')
+                error(EXIT_FAILURE, 0, "Invalid seat: %s", optarg);
+            config.seat = optarg;
+            break;
+
+        case OPT_ADV_WHEN:
+            config.adv_when = lookup(optarg, "advertising condition", whens,
+                                     COUNT(whens));
+            break;
+
+        case OPT_DISCONNECT:
+            config.disconnect = lookup(optarg, "disconnect setting", switches,
+                                       COUNT(switches));
+            break;
+
+        case OPT_CONNECTION_SLOTS:
+            config.connection_slots = number(optarg, "connection slots", 0,
+                                             255);
+            break;
+
+        case OPT_LOW_LATENCY:
+            interval(optarg, "connection interval", 8, 4000,
+                     &config.conn_min_interval, &config.conn_max_interval);
+            break;
+
+        case 'h':
+            usage(argv[0], EXIT_SUCCESS);
+
+        default:
+            usage(argv[0], EXIT_FAILURE);
+        }
+    }
+
+    if (optind < argc)
+        usage(argv[0], EXIT_FAILURE);
+}
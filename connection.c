@@ -0,0 +1,407 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define DEVICE_MATCH \
+    "type='signal',sender='org.bluez'," \
+    "interface='org.freedesktop.DBus.Properties'," \
+    "member='PropertiesChanged',arg0='org.bluez.Device1'"
+
+#define REMOVED_MATCH \
+    "type='signal',sender='org.bluez',path='/'," \
+    "interface='org.freedesktop.DBus.ObjectManager'," \
+    "member='InterfacesRemoved'"
+
+#define OWNER_MATCH \
+    "type='signal',sender='org.freedesktop.DBus'," \
+    "interface='org.freedesktop.DBus',member='NameOwnerChanged'," \
+    "arg0='org.bluez'"
+
+#define LINK_MAX 16
+
+/*
+ * Follows devices on the adapters we registered with, from connecting
+ * through bluez resolving their services, pairing, their first write and
+ * its codes being typed to disconnecting. The time from connecting to each
+ * step goes into a histogram, showing which of them phones wait on. Every
+ * connected device also counts against the controller's connection slots,
+ * not just phones that write to us. Beyond LINK_MAX connections the oldest
+ * is forgotten. A device also counts as disconnected when bluez removes it
+ * or its adapter, or goes away itself.
+ */
+
+struct link {
+    char device[DEVICE_MAX];
+    uint64_t at;
+    bool timed;
+    bool resolved;
+    bool paired;
+    bool written;
+    bool typed;
+};
+
+/* The Device1 properties followed; -1 where a change did not include it. */
+struct device_state {
+    int connected;
+    int resolved;
+    int paired;
+};
+
+static struct {
+    sd_bus *bus;
+    sd_event *event;
+    size_t next;
+    struct link links[LINK_MAX];
+} conn;
+
+static struct link *
+find(const char *device)
+{
+    for (size_t i = 0; i < LINK_MAX; i++) {
+        if (strncmp(conn.links[i].device, device, DEVICE_MAX - 1) == 0)
+            return &conn.links[i];
+    }
+
+    return NULL;
+}
+
+/* Recounts the connections on the adapter device is under. */
+static void
+count(const char *device)
+{
+    const char *slash = strrchr(device, '/');
+    size_t len = slash ? (size_t) (slash - device) : 0;
+    uint64_t n = 0;
+    size_t i;
+
+    if (len == 0 || len >= DEVICE_MAX)
+        return;
+
+    for (i = 0; i < ADAPTER_MAX && stats.adapters[i][0]; i++) {
+        if (strncmp(stats.adapters[i], device, len) == 0 &&
+            stats.adapters[i][len] == '\0')
+            break;
+    }
+    if (i == ADAPTER_MAX)
+        return;
+
+    if (!stats.adapters[i][0])
+        memcpy(stats.adapters[i], device, len);
+
+    for (size_t j = 0; j < LINK_MAX; j++) {
+        if (strncmp(conn.links[j].device, device, len) == 0 &&
+            conn.links[j].device[len] == '/')
+            n++;
+    }
+
+    if (n > stats.connections[i] && config.connection_slots > 0 &&
+        n >= config.connection_slots) {
+        fprintf(stderr, "All %llu connection slots of %s in use\n",
+                (unsigned long long) n, stats.adapters[i]);
+        stats.slots_exhausted[i]++;
+    }
+
+    stats.connections[i] = n;
+    if (n > stats.connections_max[i])
+        stats.connections_max[i] = n;
+}
+
+/* Marks a step of a connection, timing it from the connection once. */
+static void
+step(struct link *l, bool *done, struct histogram *h)
+{
+    if (*done)
+        return;
+
+    *done = true;
+    if (l->timed)
+        histogram_add(h, timer_now(conn.event) - l->at);
+}
+
+/* A device connected; one that was already when we started is not timed. */
+static void
+connected(const char *device, bool timed)
+{
+    struct link *l = find(device);
+
+    if (l)
+        return;
+
+    l = find("");
+    if (!l) {
+        l = &conn.links[conn.next];
+        conn.next = (conn.next + 1) % LINK_MAX;
+    }
+
+    *l = (struct link) { .at = timer_now(conn.event), .timed = timed };
+    snprintf(l->device, sizeof(l->device), "%s", device);
+    count(device);
+}
+
+static void
+disconnected(const char *device)
+{
+    struct link *l = find(device);
+
+    if (l) {
+        if (l->timed)
+            histogram_add(&stats.connected_hist,
+                          timer_now(conn.event) - l->at);
+
+        *l = (struct link) {};
+        count(device);
+    }
+
+    advertising_disconnected(device);
+    connparam_disconnected(device);
+}
+
+/* Disconnects every device at or below path, which bluez no longer has. */
+static void
+gone(const char *path)
+{
+    size_t len = strlen(path);
+
+    for (size_t i = 0; i < LINK_MAX; i++) {
+        char device[DEVICE_MAX];
+
+        memcpy(device, conn.links[i].device, sizeof(device));
+        if (device[0] == '\0' || strncmp(device, path, len) != 0 ||
+            (device[len] != '\0' && device[len] != '/'))
+            continue;
+
+        disconnected(device);
+    }
+
+    advertising_disconnected(path);
+}
+
+static void
+changed(const char *device, const struct device_state *s, bool timed)
+{
+    struct link *l;
+
+    if (!bluez_registered(device))
+        return;
+
+    if (s->connected > 0)
+        connected(device, timed);
+
+    l = find(device);
+    if (l && s->resolved > 0)
+        step(l, &l->resolved, &stats.resolve_hist);
+    if (l && s->paired > 0)
+        step(l, &l->paired, &stats.pair_hist);
+
+    if (s->connected == 0)
+        disconnected(device);
+}
+
+/* A device wrote to us; the first write of a connection is timed. */
+void
+connection_write(const char *device)
+{
+    struct link *l;
+
+    if (device[0] == '\0')
+        return;
+
+    connparam_written(device);
+
+    l = find(device);
+    if (!l || l->written)
+        return;
+
+    step(l, &l->written, &stats.write_hist);
+    if (!l->timed)
+        return;
+
+    stats.connect_write_last_usec = timer_now(conn.event) - l->at;
+    if (stats.connect_write_last_usec > stats.connect_write_max_usec)
+        stats.connect_write_max_usec = stats.connect_write_last_usec;
+}
+
+static int
+on_disconnect(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    if (sd_bus_error_is_set(ret_error))
+        fprintf(stderr, "Error disconnecting: %s: %s\n", ret_error->name,
+                ret_error->message);
+
+    return 0;
+}
+
+/*
+ * Everything a device sent has been typed. With --disconnect it is let go
+ * at once, freeing its connection slot for the next phone.
+ */
+void
+connection_typed(const char *device)
+{
+    struct link *l;
+    int r;
+
+    if (device[0] == '\0')
+        return;
+
+    l = find(device);
+    if (l)
+        step(l, &l->typed, &stats.type_hist);
+
+    connparam_typed(device);
+
+    if (!config.disconnect || !conn.bus)
+        return;
+
+    r = sd_bus_call_method_async(conn.bus, NULL, "org.bluez", device,
+                                 "org.bluez.Device1", "Disconnect",
+                                 on_disconnect, NULL, "");
+    if (r < 0) {
+        fprintf(stderr, "Error disconnecting %s: %s\n", device,
+                strerror(-r));
+        return;
+    }
+
+    stats.disconnects++;
+}
+
+/* Reads a Device1 property dict into s. */
+static int
+state(sd_bus_message *m, struct device_state *s)
+{
+    int r;
+
+    *s = (struct device_state) { -1, -1, -1 };
+
+    r = sd_bus_message_enter_container(m, 'a', "{sv}");
+    while (r >= 0 && (r = sd_bus_message_enter_container(m, 'e', "sv")) > 0) {
+        const char *key = NULL;
+
+        r = sd_bus_message_read(m, "s", &key);
+        if (r >= 0 && strcmp(key, "Connected") == 0)
+            r = sd_bus_message_read(m, "v", "b", &s->connected);
+        else if (r >= 0 && strcmp(key, "ServicesResolved") == 0)
+            r = sd_bus_message_read(m, "v", "b", &s->resolved);
+        else if (r >= 0 && strcmp(key, "Paired") == 0)
+            r = sd_bus_message_read(m, "v", "b", &s->paired);
+        else if (r >= 0)
+            r = sd_bus_message_skip(m, "v");
+        if (r >= 0)
+            r = sd_bus_message_exit_container(m);
+    }
+    if (r < 0)
+        return r;
+
+    return sd_bus_message_exit_container(m);
+}
+
+/* A Device1 found among bluez's objects, which may already be connected. */
+int
+connection_check(sd_bus_message *m, const char *device)
+{
+    struct device_state s;
+    int r;
+
+    r = state(m, &s);
+    if (r >= 0 && s.connected > 0)
+        changed(device, &s, false);
+
+    return r;
+}
+
+static int
+on_device(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    const char *path = sd_bus_message_get_path(m);
+    struct device_state s;
+    int r;
+
+    r = sd_bus_message_skip(m, "s");
+    if (r < 0 || !path)
+        return 0;
+
+    r = state(m, &s);
+    if (r >= 0)
+        changed(path, &s, true);
+
+    return 0;
+}
+
+static int
+on_removed(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    const char *path = NULL;
+    const char *iface = NULL;
+    int r;
+
+    r = sd_bus_message_read(m, "o", &path);
+    if (r >= 0)
+        r = sd_bus_message_enter_container(m, 'a', "s");
+
+    while (r >= 0 && (r = sd_bus_message_read(m, "s", &iface)) > 0) {
+        if (strcmp(iface, "org.bluez.Device1") == 0 ||
+            strcmp(iface, "org.bluez.Adapter1") == 0) {
+            gone(path);
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static int
+on_owner(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    const char *name = NULL;
+    const char *old = NULL;
+    const char *new = NULL;
+
+    if (sd_bus_message_read(m, "sss", &name, &old, &new) >= 0 && !new[0])
+        gone("/org/bluez");
+
+    return 0;
+}
+
+void
+setup_connections(sd_bus *bus, sd_event *event)
+{
+    static const struct {
+        const char *match;
+        sd_bus_message_handler_t handler;
+    } matches[] = {
+        { DEVICE_MATCH, on_device },
+        { REMOVED_MATCH, on_removed },
+        { OWNER_MATCH, on_owner },
+    };
+    int r;
+
+    conn.bus = bus;
+    conn.event = event;
+
+    /* For statistics and policies only: Jelling works without. */
+    for (size_t i = 0; i < COUNT(matches); i++) {
+        r = sd_bus_add_match_async(bus, NULL, matches[i].match,
+                                   matches[i].handler, NULL, NULL);
+        if (r < 0)
+            fprintf(stderr, "Error watching for connections: %s\n",
+                    strerror(-r));
+    }
+}
@@ -0,0 +1,466 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+
+/* From bluez's lib/bluetooth.h, lib/hci.h and lib/mgmt.h. */
+#define BTPROTO_HCI 1
+#define HCI_DEV_NONE 0xffff
+#define HCI_CHANNEL_CONTROL 3
+#define MGMT_OP_LOAD_CONN_PARAM 0x0035
+#define MGMT_EV_CMD_COMPLETE 0x0001
+#define MGMT_EV_CMD_STATUS 0x0002
+#define BDADDR_LE_PUBLIC 0x01
+#define BDADDR_LE_RANDOM 0x02
+
+/* Where bluetoothd keeps what it knows of each device. */
+#define STORAGE_DIR "/var/lib/bluetooth"
+#define STORED_SECTION "[ConnectionParameters]"
+
+#define PHONE_MAX 16
+
+struct sockaddr_hci {
+    sa_family_t hci_family;
+    unsigned short hci_dev;
+    unsigned short hci_channel;
+};
+
+/*
+ * Connection parameters for phones that have written to us, loaded into
+ * the kernel with the management interface's Load Connection Parameters,
+ * as bluetoothd does with those it stores. After a phone's first write the
+ * low-latency profile is loaded for it, so that it applies from the next
+ * time it connects, or, as the kernel updates a connection that is up,
+ * straight away. Once its codes are typed, the parameters bluetoothd
+ * stored for it are loaded back if it stored any; otherwise the profile
+ * stays.
+ *
+ * This needs Linux 6.11. Before that, every load first dropped the
+ * parameters of all devices that are not set to auto-connect, including
+ * those bluetoothd loaded for bonded phones, so Jelling stays off there.
+ *
+ * Commands go out on one management socket and their answers are read
+ * from the event loop, so a slow controller holds nothing up.
+ */
+
+/* In controller units: 1.25 ms for intervals, 10 ms for the timeout. */
+struct profile {
+    uint16_t min;
+    uint16_t max;
+    uint16_t latency;
+    uint16_t timeout;
+};
+
+struct phone {
+    char device[DEVICE_MAX];
+    sd_bus_slot *slot;
+    bool known;
+    uint16_t index;
+    uint8_t addr[6];
+    uint8_t type;
+    bool stored;
+    struct profile saved;
+    const struct profile *want;
+    const struct profile *loaded;
+};
+
+static struct profile fast;
+
+static struct {
+    sd_bus *bus;
+    int fd;
+    bool failed;
+    size_t next;
+    struct phone phones[PHONE_MAX];
+} cp = { .fd = -1 };
+
+static void
+put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static uint16_t
+get16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+/* Logs the first of a run of failures, and the end of the run. */
+static void
+report(const char *why)
+{
+    if (why && !cp.failed)
+        fprintf(stderr, "Error setting connection parameters: %s\n", why);
+    else if (!why && cp.failed)
+        fprintf(stderr, "Setting connection parameters works again\n");
+
+    cp.failed = why != NULL;
+}
+
+/* Reads the answers to load(). */
+static int
+on_mgmt(sd_event_source *s, int fd, uint32_t revents, void *misc)
+{
+    uint8_t buf[64];
+    ssize_t n;
+
+    /* Other events come too, longer ones cut short: only headers matter. */
+    while ((n = read(fd, buf, sizeof(buf))) >= 0) {
+        uint16_t ev;
+
+        if (n < 9)
+            continue;
+
+        ev = get16(&buf[0]);
+        if ((ev != MGMT_EV_CMD_COMPLETE && ev != MGMT_EV_CMD_STATUS) ||
+            get16(&buf[6]) != MGMT_OP_LOAD_CONN_PARAM)
+            continue;
+
+        report(buf[8] == 0 ? NULL : "rejected by the kernel");
+    }
+
+    return 0;
+}
+
+/* Sends one Load Connection Parameters; on_mgmt() reads the answer. */
+static void
+load(struct phone *p, const struct profile *want)
+{
+    uint8_t buf[23] = {};
+
+    put16(&buf[0], MGMT_OP_LOAD_CONN_PARAM);
+    put16(&buf[2], p->index);
+    put16(&buf[4], 17);
+    put16(&buf[6], 1);
+    memcpy(&buf[8], p->addr, 6);
+    buf[14] = p->type;
+    put16(&buf[15], want->min);
+    put16(&buf[17], want->max);
+    put16(&buf[19], want->latency);
+    put16(&buf[21], want->timeout);
+
+    if (write(cp.fd, buf, sizeof(buf)) < 0) {
+        report(strerror(errno));
+        return;
+    }
+
+    p->loaded = want;
+}
+
+/* Loads what p wants, once its addresses are known. */
+static void
+apply(struct phone *p)
+{
+    if (p->known && p->want && p->want != p->loaded)
+        load(p, p->want);
+}
+
+/* Reads the parameters bluetoothd stored for p, if it stored any. */
+static void
+stored(struct phone *p, const char *adapter)
+{
+    static const char *const keys[] = {
+        "MinInterval=", "MaxInterval=", "Latency=", "Timeout="
+    };
+
+    uint16_t *fields[] = {
+        &p->saved.min, &p->saved.max, &p->saved.latency, &p->saved.timeout
+    };
+    unsigned int found = 0;
+    bool section = false;
+    char path[128];
+    char line[128];
+    FILE *file;
+
+    snprintf(path, sizeof(path), STORAGE_DIR "/%s/"
+             "%02X:%02X:%02X:%02X:%02X:%02X/info", adapter,
+             p->addr[5], p->addr[4], p->addr[3], p->addr[2], p->addr[1],
+             p->addr[0]);
+
+    file = fopen(path, "re");
+    if (!file)
+        return;
+
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '[') {
+            section = strncmp(line, STORED_SECTION,
+                              strlen(STORED_SECTION)) == 0;
+            continue;
+        }
+
+        for (size_t i = 0; section && i < COUNT(keys); i++) {
+            if (strncmp(line, keys[i], strlen(keys[i])) != 0)
+                continue;
+
+            *fields[i] = strtoul(&line[strlen(keys[i])], NULL, 10);
+            found |= 1U << i;
+        }
+    }
+
+    fclose(file);
+    p->stored = found == (1U << COUNT(keys)) - 1;
+}
+
+static int
+on_adapter(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    struct phone *p = misc;
+    const char *address = NULL;
+
+    p->slot = sd_bus_slot_unref(p->slot);
+    if (sd_bus_error_is_set(ret_error) ||
+        sd_bus_message_read(m, "v", "s", &address) < 0)
+        return 0;
+
+    stored(p, address);
+    p->known = true;
+    apply(p);
+    return 0;
+}
+
+/*
+ * The kernel needs the address type too, and bluetoothd files what it
+ * stored under the adapter's address.
+ */
+static int
+on_type(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    struct phone *p = misc;
+    const char *type = NULL;
+    char adapter[DEVICE_MAX];
+    int r;
+
+    p->slot = sd_bus_slot_unref(p->slot);
+    if (sd_bus_error_is_set(ret_error) ||
+        sd_bus_message_read(m, "v", "s", &type) < 0)
+        return 0;
+
+    p->type = strcmp(type, "random") == 0 ?
+              BDADDR_LE_RANDOM : BDADDR_LE_PUBLIC;
+
+    snprintf(adapter, sizeof(adapter), "%s", p->device);
+    *strrchr(adapter, '/') = '\0';
+
+    r = sd_bus_call_method_async(cp.bus, &p->slot, "org.bluez", adapter,
+                                 "org.freedesktop.DBus.Properties", "Get",
+                                 on_adapter, p, "ss", "org.bluez.Adapter1",
+                                 "Address");
+    if (r < 0)
+        fprintf(stderr, "Error reading address of %s: %s\n", adapter,
+                strerror(-r));
+
+    return 0;
+}
+
+static struct phone *
+find(const char *device)
+{
+    for (size_t i = 0; i < PHONE_MAX; i++) {
+        if (strncmp(cp.phones[i].device, device, DEVICE_MAX - 1) == 0)
+            return &cp.phones[i];
+    }
+
+    return NULL;
+}
+
+/* Takes a slot for device, forgetting the oldest phone if need be. */
+static struct phone *
+claim(const char *device)
+{
+    unsigned int index;
+    struct phone *p;
+    uint8_t addr[6];
+    int end = 0;
+
+    /* The path spells the address out most significant byte first. */
+    sscanf(device, "/org/bluez/hci%u/dev_"
+           "%2hhx_%2hhx_%2hhx_%2hhx_%2hhx_%2hhx%n",
+           &index, &addr[5], &addr[4], &addr[3], &addr[2], &addr[1],
+           &addr[0], &end);
+    if (end == 0 || device[end] != '\0' || index >= HCI_DEV_NONE)
+        return NULL;
+
+    p = find("");
+    if (!p) {
+        p = &cp.phones[cp.next];
+        cp.next = (cp.next + 1) % PHONE_MAX;
+    }
+
+    sd_bus_slot_unref(p->slot);
+    *p = (struct phone) { .index = index };
+    memcpy(p->addr, addr, sizeof(addr));
+    snprintf(p->device, sizeof(p->device), "%s", device);
+    return p;
+}
+
+/* A phone wrote to us: connect it with the low-latency profile from now. */
+void
+connparam_written(const char *device)
+{
+    struct phone *p;
+    int r;
+
+    if (cp.fd < 0 || device[0] == '\0')
+        return;
+
+    p = find(device);
+    if (p) {
+        p->want = &fast;
+        apply(p);
+        return;
+    }
+
+    p = claim(device);
+    if (!p)
+        return;
+
+    p->want = &fast;
+    r = sd_bus_call_method_async(cp.bus, &p->slot, "org.bluez", device,
+                                 "org.freedesktop.DBus.Properties", "Get",
+                                 on_type, p, "ss", "org.bluez.Device1",
+                                 "AddressType");
+    if (r < 0)
+        fprintf(stderr, "Error reading address type of %s: %s\n", device,
+                strerror(-r));
+}
+
+/* Its codes are typed: back to what bluetoothd chose, if it chose. */
+void
+connparam_typed(const char *device)
+{
+    struct phone *p = cp.fd >= 0 && device[0] ? find(device) : NULL;
+
+    if (p && p->stored) {
+        p->want = &p->saved;
+        apply(p);
+    }
+}
+
+/* Ready for the next time it connects. */
+void
+connparam_disconnected(const char *device)
+{
+    struct phone *p = cp.fd >= 0 && device[0] ? find(device) : NULL;
+
+    if (p) {
+        p->want = &fast;
+        apply(p);
+    }
+}
+
+/* The management socket, or a negative errno. */
+static int
+control(void)
+{
+    struct sockaddr_hci sa = {
+        .hci_family = AF_BLUETOOTH,
+        .hci_dev = HCI_DEV_NONE,
+        .hci_channel = HCI_CHANNEL_CONTROL,
+    };
+    int fd;
+    int r;
+
+    fd = socket(AF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                BTPROTO_HCI);
+    if (fd < 0)
+        return -errno;
+
+    if (bind(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+        r = -errno;
+        close(fd);
+        return r;
+    }
+
+    return fd;
+}
+
+/* Whether a load leaves the parameters of other devices alone. */
+static bool
+single(const struct utsname *u)
+{
+    unsigned int major = 0;
+    unsigned int minor = 0;
+
+    if (sscanf(u->release, "%u.%u", &major, &minor) != 2)
+        return false;
+
+    return major > 6 || (major == 6 && minor >= 11);
+}
+
+void
+setup_connparam(sd_bus *bus, sd_event *event)
+{
+    struct utsname u = {};
+    int fd;
+    int r;
+
+    if (config.conn_max_interval == 0)
+        return;
+
+    if (uname(&u) < 0 || !single(&u)) {
+        fprintf(stderr, "Not setting connection parameters: Linux %s "
+                "would drop those of other devices\n", u.release);
+        return;
+    }
+
+    /*
+     * Milliseconds to 1.25 ms units, rounded down but not below the 7.5 ms
+     * LE allows. The supervision timeout is 2 s, or more if it has to
+     * outlast two of the longest intervals.
+     */
+    fast.min = config.conn_min_interval * 4 / 5;
+    fast.max = config.conn_max_interval * 4 / 5;
+    if (fast.min < 6)
+        fast.min = 6;
+    if (fast.max < fast.min)
+        fast.max = fast.min;
+    fast.timeout = fast.max / 4 + 1;
+    if (fast.timeout < 200)
+        fast.timeout = 200;
+
+    /* Not fatal: phones just connect with the usual parameters. */
+    fd = control();
+    if (fd < 0) {
+        fprintf(stderr, "Error opening management socket: %s\n",
+                strerror(-fd));
+        return;
+    }
+
+    r = sd_event_add_io(event, NULL, fd, EPOLLIN, on_mgmt, NULL);
+    if (r < 0) {
+        fprintf(stderr, "Error watching management socket: %s\n",
+                strerror(-r));
+        close(fd);
+        return;
+    }
+
+    cp.bus = bus;
+    cp.fd = fd;
+}
@@ -0,0 +1,170 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <systemd/sd-id128.h>
+
+/*
+ * Recently accepted writes, remembered only as SipHash-2-4 MACs of the
+ * device and payload under a key drawn at startup, so no code is kept
+ * once it has been typed. Lookups compare every entry in constant time.
+ */
+
+#define ROTL(x, b) (uint64_t) (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND(v0, v1, v2, v3) do { \
+    v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+    v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+} while (0)
+
+static uint64_t
+le64(const uint8_t *p)
+{
+    uint64_t v = 0;
+
+    for (size_t i = 0; i < 8; i++)
+        v |= (uint64_t) p[i] << (8 * i);
+
+    return v;
+}
+
+uint64_t
+siphash24(const uint8_t key[16], const uint8_t *in, size_t len)
+{
+    uint64_t k0 = le64(key);
+    uint64_t k1 = le64(key + 8);
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+    uint64_t b = (uint64_t) len << 56;
+    size_t tail = len & 7;
+    uint64_t m;
+
+    for (const uint8_t *end = in + len - tail; in < end; in += 8) {
+        m = le64(in);
+        v3 ^= m;
+        SIPROUND(v0, v1, v2, v3);
+        SIPROUND(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    for (size_t i = 0; i < tail; i++)
+        b |= (uint64_t) in[i] << (8 * i);
+
+    v3 ^= b;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    for (size_t i = 0; i < 4; i++)
+        SIPROUND(v0, v1, v2, v3);
+
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+void
+dedup_init(struct dedup *d, uint64_t window)
+{
+    sd_id128_t key;
+    int r;
+
+    *d = (struct dedup) { .window = window };
+    if (window == 0)
+        return;
+
+    r = sd_id128_randomize(&key);
+    if (r < 0) {
+        fprintf(stderr, "Error keying duplicate suppression: %s; "
+                "disabled\n", strerror(-r));
+        d->window = 0;
+        return;
+    }
+
+    memcpy(d->key, key.bytes, sizeof(d->key));
+}
+
+uint64_t
+dedup_mac(const struct dedup *d, const char *device,
+          const struct record *records, size_t n)
+{
+    uint8_t buf[DEVICE_MAX + PENDING_MAX * (2 + OTP_MAX)] = {};
+    size_t len = strnlen(device, DEVICE_MAX - 1);
+    uint64_t mac;
+
+    /* The NUL and the length of each code keep the fields apart. */
+    memcpy(buf, device, len++);
+    for (size_t i = 0; i < n && i < PENDING_MAX; i++) {
+        buf[len++] = records[i].size;
+        buf[len++] = records[i].enter;
+        memcpy(&buf[len], records[i].bytes, records[i].size);
+        len += records[i].size;
+    }
+
+    mac = siphash24(d->key, buf, len);
+
+    memset(buf, 0, sizeof(buf));
+    __asm__ __volatile__("" : : "r"(buf) : "memory");
+    return mac;
+}
+
+/* Whether mac was remembered within the window; timing does not say. */
+bool
+dedup_seen(const struct dedup *d, uint64_t mac, uint64_t now)
+{
+    uint64_t found = 0;
+
+    if (d->window == 0)
+        return false;
+
+    for (size_t i = 0; i < DEDUP_MAX; i++) {
+        const struct dedup_entry *e = &d->entries[i];
+        uint64_t fresh = e->used & (now - e->at < d->window);
+        uint64_t diff = e->mac ^ mac;
+
+        /* diff is zero only for a match: fold it down to one bit. */
+        diff |= diff >> 32;
+        diff |= diff >> 16;
+        diff |= diff >> 8;
+        diff |= diff >> 4;
+        diff |= diff >> 2;
+        diff |= diff >> 1;
+        found |= fresh & ~diff & 1;
+    }
+
+    return found != 0;
+}
+
+/* Remembers mac, replacing the oldest entry. */
+void
+dedup_add(struct dedup *d, uint64_t mac, uint64_t now)
+{
+    if (d->window == 0)
+        return;
+
+    d->entries[d->next] = (struct dedup_entry) {
+        .mac = mac, .at = now, .used = true
+    };
+    d->next = (d->next + 1) % DEDUP_MAX;
+}
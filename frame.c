@@ -0,0 +1,121 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <errno.h>
+
+/*
+ * A written value is either a raw code, typed and followed by Enter, or a
+ * batch of codes typed one after another:
+ *
+ *     FRAME_V1, then for each code: flags, length, that many digits
+ *
+ * The version byte is not a digit, so no raw code reads as a batch. Flag
+ * bit 0 asks for Enter after the code; the other bits must be clear.
+ */
+#define FRAME_V1 0x01
+#define FRAME_ENTER 0x01
+
+static bool
+digits(const uint8_t *bytes, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (char2key(bytes[i]) == KEY_UNKNOWN)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Splits value into records, or with partial set checks that it can still
+ * become a valid value: one that ends inside a code gives -EAGAIN then.
+ */
+static int
+parse(const uint8_t *value, size_t size, struct record *records, bool partial)
+{
+    size_t n = 0;
+
+    if (size == 0)
+        return -EMSGSIZE;
+
+    if (value[0] != FRAME_V1) {
+        if (size > OTP_MAX)
+            return -EMSGSIZE;
+        if (!digits(value, size))
+            return -EILSEQ;
+
+        records[0] = (struct record) { value, size, true };
+        return 1;
+    }
+
+    for (size_t i = 1; i < size; n++) {
+        uint8_t flags;
+        size_t len;
+
+        if (size - i < 2) {
+            if (value[i] & ~FRAME_ENTER)
+                return -EILSEQ;
+            return partial ? -EAGAIN : -EILSEQ;
+        }
+
+        flags = value[i++];
+        len = value[i++];
+        if (flags & ~FRAME_ENTER || len == 0)
+            return -EILSEQ;
+        if (len > OTP_MAX || n == PENDING_MAX)
+            return -EMSGSIZE;
+        if (!digits(&value[i], len < size - i ? len : size - i))
+            return -EILSEQ;
+        if (len > size - i)
+            return partial ? -EAGAIN : -EILSEQ;
+
+        records[n] = (struct record) {
+            &value[i], len, flags & FRAME_ENTER
+        };
+        i += len;
+    }
+
+    if (n == 0 && partial)
+        return -EAGAIN;
+
+    return n > 0 ? (int) n : -EILSEQ;
+}
+
+/*
+ * Splits value into records[PENDING_MAX], checking all of them before any
+ * is typed. Returns the number of records, -EILSEQ for a value that is
+ * malformed or not all digits, or -EMSGSIZE for a code longer than
+ * OTP_MAX or more codes than fit in the queue.
+ */
+int
+frame_parse(const uint8_t *value, size_t size, struct record *records)
+{
+    return parse(value, size, records, false);
+}
+
+/*
+ * As frame_parse(), for the first chunks of a long write: a value that is
+ * valid so far but ends inside a code gives -EAGAIN, so that bad bytes are
+ * refused with the chunk that carries them.
+ */
+int
+frame_prefix(const uint8_t *value, size_t size, struct record *records)
+{
+    return parse(value, size, records, true);
+}
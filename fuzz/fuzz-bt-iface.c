@@ -0,0 +1,87 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fuzz.h"
+
+#include <stdio.h>
+
+static const char *const ifaces[] = {
+    "org.bluez.GattManager1",
+    "org.bluez.LEAdvertisingManager1",
+    "org.bluez.Adapter1",
+    "org.bluez.Device1",
+    "org.freedesktop.DBus.Introspectable",
+    "org.freedesktop.DBus.Properties",
+};
+
+static const char *const props[] = {
+    "Address", "Powered", "Connected", "ServicesResolved", "Paired",
+    "ActiveInstances", "SupportedInstances", "SupportedIncludes",
+};
+
+/*
+ * Input layout: flags, adapter index, interface count, then for each
+ * interface its name and property dictionary. Flag bit 0 appends a stray
+ * argument so the signature check is exercised too.
+ */
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    SCOPED(sd_bus_message) *m = NULL;
+    struct fuzz f = { data, size };
+    char obj[sizeof("/org/bluez/hci255")];
+    uint8_t flags;
+    uint8_t count;
+    sd_bus *bus;
+
+    bus = harness_bus();
+    if (sd_bus_message_new_signal(bus, &m, "/",
+                                  "org.freedesktop.DBus.ObjectManager",
+                                  "InterfacesAdded") < 0)
+        return 0;
+
+    flags = fuzz_u8(&f);
+    snprintf(obj, sizeof(obj), "/org/bluez/hci%u", fuzz_u8(&f));
+    if (sd_bus_message_append(m, "o", obj) < 0)
+        return 0;
+
+    if (sd_bus_message_open_container(m, 'a', "{sa{sv}}") < 0)
+        return 0;
+
+    count = fuzz_u8(&f) % 8;
+    for (uint8_t i = 0; i < count; i++) {
+        if (sd_bus_message_open_container(m, 'e', "sa{sv}") < 0 ||
+            sd_bus_message_append(m, "s",
+                                  fuzz_string(&f, ifaces, COUNT(ifaces))) < 0 ||
+            fuzz_append_dict(&f, m, props, COUNT(props)) < 0 ||
+            sd_bus_message_close_container(m) < 0)
+            return 0;
+    }
+
+    if (sd_bus_message_close_container(m) < 0)
+        return 0;
+
+    if (flags & 1 && sd_bus_message_append(m, "s", "") < 0)
+        return 0;
+
+    if (harness_seal(m) < 0)
+        return 0;
+
+    on_bt_iface(m, bus, NULL);
+    harness_pump();
+    return 0;
+}
@@ -0,0 +1,61 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fuzz.h"
+
+static const char *const options[] = {
+    "offset", "mtu", "device", "link", "type", "prepare-authorize",
+};
+
+/*
+ * Input layout: flags, value bytes, then the options dictionary. Flag bit 0
+ * appends a stray argument so the signature check is exercised too.
+ */
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    SCOPED(sd_bus_message) *m = NULL;
+    sd_bus_error err = SD_BUS_ERROR_NULL;
+    struct fuzz f = { data, size };
+    const uint8_t *value;
+    uint8_t flags;
+    size_t len;
+
+    if (sd_bus_message_new_method_call(harness_bus(), &m, NULL, CHR_PATH,
+                                       "org.bluez.GattCharacteristic1",
+                                       "WriteValue") < 0)
+        return 0;
+
+    flags = fuzz_u8(&f);
+    value = fuzz_bytes(&f, &len);
+    if (sd_bus_message_append_array(m, 'y', value, len) < 0)
+        return 0;
+
+    if (fuzz_append_dict(&f, m, options, COUNT(options)) < 0)
+        return 0;
+
+    if (flags & 1 && sd_bus_message_append(m, "s", "") < 0)
+        return 0;
+
+    if (harness_seal(m) < 0)
+        return 0;
+
+    chr_writevalue(m, harness_keyboard(SINK_FD), &err);
+    sd_bus_error_free(&err);
+    harness_pump();
+    return 0;
+}
@@ -0,0 +1,145 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fuzz.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+uint8_t
+fuzz_u8(struct fuzz *f)
+{
+    uint8_t b;
+
+    if (f->size == 0)
+        return 0;
+
+    b = *f->data++;
+    f->size--;
+    return b;
+}
+
+const uint8_t *
+fuzz_bytes(struct fuzz *f, size_t *len)
+{
+    const uint8_t *b = f->data;
+
+    *len = fuzz_u8(f);
+    if (*len > f->size)
+        *len = f->size;
+
+    f->data += *len;
+    f->size -= *len;
+    return b;
+}
+
+const char *
+fuzz_string(struct fuzz *f, const char *const *dict, size_t n)
+{
+    static char buf[UINT8_MAX + 1];
+    const uint8_t *b;
+    uint8_t sel;
+    size_t len;
+
+    /* Mostly pick interesting names; otherwise make up a printable one. */
+    sel = fuzz_u8(f);
+    if (sel < n)
+        return dict[sel];
+
+    b = fuzz_bytes(f, &len);
+    for (size_t i = 0; i < len; i++)
+        buf[i] = ' ' + b[i] % ('~' - ' ' + 1);
+    buf[len] = '\0';
+    return buf;
+}
+
+int
+fuzz_append_variant(struct fuzz *f, sd_bus_message *m)
+{
+    char path[sizeof("/org/bluez/hci255/dev_FF_FF_FF_FF_FF_FF")];
+    uint8_t tag = fuzz_u8(f);
+    uint8_t v[6];
+    int r;
+    const uint8_t *b;
+    size_t len;
+
+    for (size_t i = 0; i < COUNT(v); i++)
+        v[i] = fuzz_u8(f);
+
+    switch (tag % 8) {
+    case 0: return sd_bus_message_append(m, "v", "y", v[0]);
+    case 1: return sd_bus_message_append(m, "v", "b", v[0] & 1);
+    case 2: return sd_bus_message_append(m, "v", "q", v[0] << 8 | v[1]);
+    case 3: return sd_bus_message_append(m, "v", "u",
+                                         (uint32_t) v[0] << 24 | v[1] << 16 |
+                                         v[2] << 8 | v[3]);
+    case 4: return sd_bus_message_append(m, "v", "s", fuzz_string(f, NULL, 0));
+    case 5:
+        snprintf(path, sizeof(path), "/org/bluez/hci%u", v[0]);
+        return sd_bus_message_append(m, "v", "o", path);
+    case 6:
+        snprintf(path, sizeof(path),
+                 "/org/bluez/hci%u/dev_%02X_%02X_%02X_%02X_%02X_%02X",
+                 v[0] % 4, v[0], v[1], v[2], v[3], v[4], v[5]);
+        return sd_bus_message_append(m, "v", "o", path);
+    default:
+        break;
+    }
+
+    r = sd_bus_message_open_container(m, 'v', "ay");
+    if (r < 0)
+        return r;
+
+    b = fuzz_bytes(f, &len);
+    r = sd_bus_message_append_array(m, 'y', b, len);
+    if (r < 0)
+        return r;
+
+    return sd_bus_message_close_container(m);
+}
+
+int
+fuzz_append_dict(struct fuzz *f, sd_bus_message *m,
+                 const char *const *keys, size_t n)
+{
+    uint8_t count = fuzz_u8(f) % 16;
+    int r;
+
+    r = sd_bus_message_open_container(m, 'a', "{sv}");
+    if (r < 0)
+        return r;
+
+    for (uint8_t i = 0; i < count; i++) {
+        r = sd_bus_message_open_container(m, 'e', "sv");
+        if (r < 0)
+            return r;
+
+        r = sd_bus_message_append(m, "s", fuzz_string(f, keys, n));
+        if (r < 0)
+            return r;
+
+        r = fuzz_append_variant(f, m);
+        if (r < 0)
+            return r;
+
+        r = sd_bus_message_close_container(m);
+        if (r < 0)
+            return r;
+    }
+
+    return sd_bus_message_close_container(m);
+}
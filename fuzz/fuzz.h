@@ -0,0 +1,49 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "harness.h"
+
+/*
+ * Fuzz inputs are consumed front to back as a stream of small,
+ * length-prefixed fields. Running out of input yields zeros, so every
+ * prefix of an input is itself a valid input.
+ */
+struct fuzz {
+    const uint8_t *data;
+    size_t size;
+};
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+uint8_t
+fuzz_u8(struct fuzz *f);
+
+const uint8_t *
+fuzz_bytes(struct fuzz *f, size_t *len);
+
+const char *
+fuzz_string(struct fuzz *f, const char *const *dict, size_t n);
+
+int
+fuzz_append_variant(struct fuzz *f, sd_bus_message *m);
+
+int
+fuzz_append_dict(struct fuzz *f, sd_bus_message *m,
+                 const char *const *keys, size_t n);
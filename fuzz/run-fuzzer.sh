@@ -0,0 +1,14 @@
+#!/bin/sh
+# Runs one fuzz target for a fixed time, starting from its checked-in corpus.
+# New inputs go to a scratch corpus in the build directory. libFuzzer's final
+# stats (stat::average_exec_per_sec et al.) are printed on exit, so parser
+# throughput can be compared between builds.
+set -e
+
+fuzzer="$1"
+seeds="$2"
+work="${MESON_BUILD_ROOT:-.}/fuzz/$(basename "$seeds").corpus"
+
+mkdir -p "$work"
+exec "$fuzzer" -print_final_stats=1 -close_fd_mask=2 \
+    -max_total_time="${FUZZ_TIME:-60}" "$work" "$seeds"
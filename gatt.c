@@ -0,0 +1,504 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Authors: Nathaniel McCallum <npmccallum@redhat.com>
+ *
+ * Copyright (C) 2015  Nathaniel McCallum, Red Hat
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <error.h>
+
+#define SVC_IFACE "org.bluez.GattService1"
+#define CHR_IFACE "org.bluez.GattCharacteristic1"
+
+/*
+ * Attribute handles asked of bluez, so that the GATT database, and with it
+ * its Database Hash, is the same every time bluez or Jelling starts and
+ * bonded phones can keep their cached discovery. bluez's own services sit
+ * at the bottom of the handle space and other applications are allocated
+ * from there upwards. bluez takes a characteristic's handle as that of its
+ * value and puts the declaration just before it, so each characteristic
+ * spans its handle and the one below.
+ */
+#define SVC_HANDLE 0x8000
+#define CHR_HANDLE 0x8002
+#define CAP_HANDLE 0x8004
+
+/*
+ * The capabilities characteristic's value, version 1, multi-byte fields
+ * little-endian:
+ *
+ *   0      version (CAP_VERSION)
+ *   1      CAP_* feature flags
+ *   2-3    longest value accepted, including long writes
+ *   4      most codes in one write
+ *   5      longest code
+ *   6      keymap (CAP_KEYMAP_DIGITS: 0-9 and Enter by keycode, so the
+ *          keyboard layout does not matter)
+ *   7      codes queued ahead of typing
+ *   8-9    milliseconds each key is held, and between keys
+ *   10     codes a device may send at once
+ *   11-12  codes per minute from a device after that, 0 if unlimited
+ *
+ * Later versions only append fields.
+ */
+#define CAP_VERSION 0x01
+#define CAP_BATCH 0x01
+#define CAP_LONG_WRITE 0x02
+#define CAP_EARLY_ACK 0x04
+#define CAP_NOTIFY 0x08
+#define CAP_SUPERSEDE 0x10
+#define CAP_DEDUP 0x20
+#define CAP_KEYMAP_DIGITS 0x01
+#define CAP_SIZE 13
+
+/*
+ * The GATT application is described by the service and characteristic
+ * structures below and the objects[] table that places them on the bus.
+ * Every property is read by a getter that takes the field at its offset
+ * in the structure, so one vtable serves each kind of object.
+ */
+
+struct service {
+    const char *uuid;
+    bool primary;
+    const char *const *includes;
+    uint16_t handle;
+};
+
+struct characteristic {
+    const char *uuid;
+    const char *service;
+    const char *const *flags;
+    uint16_t handle;
+    sd_bus_message_handler_t read;
+    sd_bus_message_handler_t write;
+};
+
+#define FIELD(name, sig, func, type, member) \
+    SD_BUS_PROPERTY(name, sig, func, offsetof(type, member), \
+                    SD_BUS_VTABLE_PROPERTY_CONST)
+
+#define HANDLE(type) \
+    SD_BUS_WRITABLE_PROPERTY("Handle", "q", get_handle, set_handle, \
+                             offsetof(type, handle), \
+                             SD_BUS_VTABLE_UNPRIVILEGED)
+
+static bool fixed = true;
+static struct keyboard *keyboard;
+
+static int
+get_string(sd_bus *bus, const char *path, const char *interface,
+           const char *property, sd_bus_message *reply, void *userdata,
+           sd_bus_error *ret_error)
+{
+    return sd_bus_message_append_basic(reply, 's',
+                                       *(const char **) userdata);
+}
+
+static int
+get_path(sd_bus *bus, const char *path, const char *interface,
+         const char *property, sd_bus_message *reply, void *userdata,
+         sd_bus_error *ret_error)
+{
+    return sd_bus_message_append_basic(reply, 'o',
+                                       *(const char **) userdata);
+}
+
+static int
+get_bool(sd_bus *bus, const char *path, const char *interface,
+         const char *property, sd_bus_message *reply, void *userdata,
+         sd_bus_error *ret_error)
+{
+    int b = *(const bool *) userdata;
+
+    return sd_bus_message_append_basic(reply, 'b', &b);
+}
+
+/* Appends a NULL-terminated list, which may itself be NULL, as an array. */
+static int
+append_list(sd_bus_message *reply, char type, const char *const *list)
+{
+    char sig[] = { type, '\0' };
+    int r;
+
+    r = sd_bus_message_open_container(reply, 'a', sig);
+    if (r < 0)
+        return r;
+
+    for (size_t i = 0; list && list[i]; i++) {
+        r = sd_bus_message_append_basic(reply, type, list[i]);
+        if (r < 0)
+            return r;
+    }
+
+    return sd_bus_message_close_container(reply);
+}
+
+static int
+get_strings(sd_bus *bus, const char *path, const char *interface,
+            const char *property, sd_bus_message *reply, void *userdata,
+            sd_bus_error *ret_error)
+{
+    return append_list(reply, 's', *(const char *const **) userdata);
+}
+
+static int
+get_paths(sd_bus *bus, const char *path, const char *interface,
+          const char *property, sd_bus_message *reply, void *userdata,
+          sd_bus_error *ret_error)
+{
+    return append_list(reply, 'o', *(const char *const **) userdata);
+}
+
+static int
+get_handle(sd_bus *bus, const char *path, const char *interface,
+           const char *property, sd_bus_message *reply, void *userdata,
+           sd_bus_error *ret_error)
+{
+    uint16_t handle = fixed ? *(const uint16_t *) userdata : 0;
+
+    return sd_bus_message_append_basic(reply, 'q', &handle);
+}
+
+/*
+ * bluez writes back the handle it allocated. The layout is fixed, so there
+ * is nothing to keep; the handle is only checked to be one.
+ */
+static int
+set_handle(sd_bus *bus, const char *path, const char *interface,
+           const char *property, sd_bus_message *value, void *userdata,
+           sd_bus_error *ret_error)
+{
+    uint16_t handle = 0;
+
+    return sd_bus_message_read(value, "q", &handle);
+}
+
+/*
+ * Whether Handle asks for the fixed layout, or leaves handles to bluez
+ * where it cannot place them (say, because another application holds
+ * them). bluez.c sets it for the adapter it is registering with.
+ */
+void
+gatt_fixed_handles(bool on)
+{
+    fixed = on;
+}
+
+static int
+chr_notsup(sd_bus_message *m, void *misc, sd_bus_error *err)
+{
+    return sd_bus_error_set(
+        err, "org.bluez.Error.NotSupported", "Not supported"
+    );
+}
+
+/* Reads the options of a WriteValue call, skipping those Jelling ignores. */
+static int
+parse_options(sd_bus_message *m, struct write_options *opts)
+{
+    const char *type = NULL;
+    int authorize = false;
+    int r;
+
+    *opts = (struct write_options) { .device = "", .link = "" };
+
+    r = sd_bus_message_enter_container(m, 'a', "{sv}");
+    if (r < 0)
+        return r;
+
+    while ((r = sd_bus_message_enter_container(m, 'e', "sv")) > 0) {
+        const char *key = NULL;
+
+        r = sd_bus_message_read(m, "s", &key);
+        if (r < 0)
+            return r;
+
+        if (strcmp(key, "device") == 0)
+            r = sd_bus_message_read(m, "v", "o", &opts->device);
+        else if (strcmp(key, "link") == 0)
+            r = sd_bus_message_read(m, "v", "s", &opts->link);
+        else if (strcmp(key, "offset") == 0)
+            r = sd_bus_message_read(m, "v", "q", &opts->offset);
+        else if (strcmp(key, "mtu") == 0)
+            r = sd_bus_message_read(m, "v", "q", &opts->mtu);
+        else if (strcmp(key, "type") == 0)
+            r = sd_bus_message_read(m, "v", "s", &type);
+        else if (strcmp(key, "prepare-authorize") == 0)
+            r = sd_bus_message_read(m, "v", "b", &authorize);
+        else
+            r = sd_bus_message_skip(m, "v");
+        if (r < 0)
+            return r;
+
+        r = sd_bus_message_exit_container(m);
+        if (r < 0)
+            return r;
+    }
+    if (r < 0)
+        return r;
+
+    /* bluez >= 5.51 marks the chunks of an executed long write "reliable". */
+    opts->prepared = type && strcmp(type, "reliable") == 0;
+    opts->authorize = authorize;
+    return sd_bus_message_exit_container(m);
+}
+
+int
+chr_writevalue(sd_bus_message *m, void *misc, sd_bus_error *err)
+{
+    struct keyboard *kbd = misc;
+    struct write_options opts;
+    const uint8_t *bytes = NULL;
+    size_t size = 0;
+    int r;
+
+    r = sd_bus_message_has_signature(m, "aya{sv}");
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_read_array(m, 'y', (const void **) &bytes, &size);
+    if (r < 0)
+        return r;
+
+    r = parse_options(m, &opts);
+    if (r < 0)
+        return r;
+
+    advertising_seen(opts.device);
+    connection_write(opts.device);
+
+    if (size == 0 || size > longwrite_chunk(&opts)) {
+        return sd_bus_reply_method_errorf(
+            m, "org.bluez.Error.InvalidValueLength", "Invalid value length"
+        );
+    }
+
+    /* Validated whole, then accepted now or blocked with the reply deferred. */
+    r = longwrite(kbd, m, &opts, bytes, size);
+    switch (r) {
+    case -EILSEQ:
+        return sd_bus_reply_method_errorf(
+            m, "org.bluez.Error.NotPermitted", "Invalid value"
+        );
+
+    case -EINVAL:
+        return sd_bus_reply_method_errorf(
+            m, "org.bluez.Error.InvalidOffset", "Invalid offset"
+        );
+
+    case -EMSGSIZE:
+        return sd_bus_reply_method_errorf(
+            m, "org.bluez.Error.InvalidValueLength", "Invalid value length"
+        );
+
+    case -EBUSY:
+        return sd_bus_reply_method_errorf(
+            m, "org.bluez.Error.Failed", "Rate limited"
+        );
+
+    case 0:
+        return 1;
+    }
+    if (r < 0) {
+        return sd_bus_reply_method_errorf(
+            m, "org.bluez.Error.Failed", "Write failed"
+        );
+    }
+
+    return sd_bus_reply_method_return(m, "");
+}
+
+/* A setting for a field of size bits, saturating rather than wrapping. */
+static uint64_t
+clamp(uint64_t value, unsigned int bits)
+{
+    uint64_t max = (1ULL << bits) - 1;
+
+    return value < max ? value : max;
+}
+
+static size_t
+capabilities(uint8_t caps[CAP_SIZE])
+{
+    uint64_t batch = PENDING_MAX;
+    uint64_t rate = 0;
+    uint16_t pace = PACE_USEC / 1000;
+
+    /* A batch may not exceed the burst; see keyboard_type(). */
+    if (config.rate_interval > 0) {
+        rate = clamp(60 * 1000000ULL / config.rate_interval, 16);
+        if (config.rate_burst < batch)
+            batch = config.rate_burst;
+    }
+
+    caps[0] = CAP_VERSION;
+    caps[1] = CAP_BATCH | CAP_LONG_WRITE | CAP_EARLY_ACK;
+    if (config.supersede)
+        caps[1] |= CAP_SUPERSEDE;
+    if (config.dedup_window > 0)
+        caps[1] |= CAP_DEDUP;
+    caps[2] = VALUE_MAX & 0xff;
+    caps[3] = VALUE_MAX >> 8;
+    caps[4] = batch;
+    caps[5] = OTP_MAX;
+    caps[6] = CAP_KEYMAP_DIGITS;
+    caps[7] = clamp(config.queue_depth, 8);
+    caps[8] = pace & 0xff;
+    caps[9] = pace >> 8;
+    caps[10] = clamp(config.rate_burst, 8);
+    caps[11] = rate & 0xff;
+    caps[12] = rate >> 8;
+
+    return CAP_SIZE;
+}
+
+/* Reads are short, so bluez may ask for the rest at an offset. */
+static int
+chr_capabilities(sd_bus_message *m, void *misc, sd_bus_error *err)
+{
+    SCOPED(sd_bus_message) *reply = NULL;
+    struct write_options opts;
+    uint8_t caps[CAP_SIZE];
+    size_t size;
+    int r;
+
+    r = parse_options(m, &opts);
+    if (r < 0)
+        return r;
+
+    size = capabilities(caps);
+    if (opts.offset > size) {
+        return sd_bus_reply_method_errorf(
+            m, "org.bluez.Error.InvalidOffset", "Invalid offset"
+        );
+    }
+
+    r = sd_bus_message_new_method_return(m, &reply);
+    if (r < 0)
+        return r;
+
+    r = sd_bus_message_append_array(reply, 'y', caps + opts.offset,
+                                    size - opts.offset);
+    if (r < 0)
+        return r;
+
+    return sd_bus_send(NULL, reply, NULL);
+}
+
+static int
+meth_noop(sd_bus_message *m, void *misc, sd_bus_error *err)
+{
+    return sd_bus_reply_method_return(m, "");
+}
+
+static int
+chr_read(sd_bus_message *m, void *misc, sd_bus_error *err)
+{
+    const struct characteristic *c = misc;
+
+    if (!c->read)
+        return chr_notsup(m, misc, err);
+
+    return c->read(m, keyboard, err);
+}
+
+static int
+chr_write(sd_bus_message *m, void *misc, sd_bus_error *err)
+{
+    const struct characteristic *c = misc;
+
+    if (!c->write)
+        return chr_notsup(m, misc, err);
+
+    return c->write(m, keyboard, err);
+}
+
+const sd_bus_vtable svc_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    FIELD("UUID", "s", get_string, struct service, uuid),
+    FIELD("Primary", "b", get_bool, struct service, primary),
+    FIELD("Includes", "ao", get_paths, struct service, includes),
+    HANDLE(struct service),
+    SD_BUS_VTABLE_END
+};
+
+const sd_bus_vtable chr_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    FIELD("UUID", "s", get_string, struct characteristic, uuid),
+    FIELD("Service", "o", get_path, struct characteristic, service),
+    FIELD("Flags", "as", get_strings, struct characteristic, flags),
+    HANDLE(struct characteristic),
+    METH("ReadValue", "a{sv}", "ay", chr_read),
+    METH("WriteValue", "aya{sv}", "", chr_write),
+    METH("StartNotify", "", "", chr_notsup),
+    METH("StopNotify", "", "", meth_noop),
+    SD_BUS_VTABLE_END
+};
+
+static const struct service jelling = {
+    .uuid = SVC_UUID,
+    .primary = true,
+    .handle = SVC_HANDLE,
+};
+
+static const struct characteristic otp = {
+    .uuid = CHR_UUID,
+    .service = SVC_PATH,
+    .flags = (const char *const []) { "secure-write", NULL },
+    .handle = CHR_HANDLE,
+    .write = chr_writevalue,
+};
+
+static const struct characteristic caps = {
+    .uuid = CAP_UUID,
+    .service = SVC_PATH,
+    .flags = (const char *const []) { "read", NULL },
+    .handle = CAP_HANDLE,
+    .read = chr_capabilities,
+};
+
+/* Registered in this order, each service ahead of its characteristics. */
+const struct gatt_object gatt_objects[] = {
+    { SVC_PATH, SVC_IFACE, svc_vtable, &jelling },
+    { CHR_PATH, CHR_IFACE, chr_vtable, &otp },
+    { CAP_PATH, CHR_IFACE, chr_vtable, &caps },
+    {}
+};
+
+void
+setup_objects(sd_bus *bus, struct keyboard *kbd)
+{
+    int r;
+
+    keyboard = kbd;
+
+    r = sd_bus_add_object_manager(bus, NULL, MAN_PATH);
+    if (r < 0)
+        error(EXIT_FAILURE, -r, "Error adding object manager");
+
+    for (const struct gatt_object *o = gatt_objects; o->path; o++) {
+        r = sd_bus_add_object_vtable(bus, NULL, o->path, o->interface,
+                                     o->vtable, (void *) o->data);
+        if (r < 0)
+            error(EXIT_FAILURE, -r, "Error creating %s", o->path);
+    }
+}
@@ -0,0 +1,122 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "harness.h"
+
+#include <stdlib.h>
+
+#include <sys/socket.h>
+
+/*
+ * The handlers under test need a live bus: replies and async method calls
+ * are sent on the bus the message came from. We connect a client to an
+ * in-process peer over a socketpair, so nothing leaves the process and the
+ * peer answers (or drops) whatever the handlers send.
+ */
+static sd_bus *client;
+static sd_bus *server;
+
+sd_bus *
+harness_bus(void)
+{
+    sd_id128_t id;
+    int fds[2];
+    int r;
+
+    if (client)
+        return client;
+
+    r = socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                   0, fds);
+    if (r < 0)
+        abort();
+
+    if (sd_id128_randomize(&id) < 0 ||
+        sd_bus_new(&server) < 0 ||
+        sd_bus_set_fd(server, fds[0], fds[0]) < 0 ||
+        sd_bus_set_server(server, true, id) < 0 ||
+        sd_bus_set_anonymous(server, true) < 0 ||
+        sd_bus_start(server) < 0 ||
+        sd_bus_new(&client) < 0 ||
+        sd_bus_set_fd(client, fds[1], fds[1]) < 0 ||
+        sd_bus_start(client) < 0)
+        abort();
+
+    /* Both ends are non-blocking: alternate until authentication is done. */
+    for (size_t i = 0; sd_bus_is_ready(client) <= 0; i++) {
+        if (i > 1024 ||
+            sd_bus_process(client, NULL) < 0 ||
+            sd_bus_process(server, NULL) < 0)
+            abort();
+    }
+
+    return client;
+}
+
+sd_bus *
+harness_peer(void)
+{
+    harness_bus();
+    return server;
+}
+
+int
+harness_seal(sd_bus_message *m)
+{
+    static uint64_t cookie;
+    int r;
+
+    /* Make the message look as if it had just been received. */
+    r = sd_bus_message_seal(m, ++cookie, 0);
+    if (r < 0)
+        return r;
+
+    return sd_bus_message_rewind(m, true);
+}
+
+/* Delivers what both ends have queued and runs the virtual timers. */
+void
+harness_pump(void)
+{
+    for (size_t i = 0; i < 4096; i++) {
+        int c = sd_bus_process(client, NULL);
+        int s = sd_bus_process(server, NULL);
+        if (c < 0 || s < 0)
+            abort();
+        if (c == 0 && s == 0 && !vclock_step())
+            break;
+    }
+}
+
+/*
+ * A keyboard on the virtual clock, emptied on every call: harness_pump()
+ * types whatever was queued on it in simulated time.
+ */
+struct keyboard *
+harness_keyboard(uinput fd)
+{
+    static struct keyboard kbd;
+    static bool attached;
+
+    if (attached)
+        keyboard_cleanup(&kbd);
+
+    vclock_install();
+    keyboard_attach(&kbd, NULL, fd);
+    attached = true;
+    return &kbd;
+}
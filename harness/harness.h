@@ -0,0 +1,84 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "jelling.h"
+
+#include <limits.h>
+
+/*
+ * Support code shared by the fuzz targets and benchmarks. Handlers are
+ * driven directly, on a bus connected to an in-process peer, with key
+ * events going to the sink in sink.c instead of uinput.
+ */
+
+/* sink.c never writes, so any fd that is not -1 marks the device present. */
+#define SINK_FD INT_MAX
+
+/* The properties of the last advertisement registered with the mock. */
+struct mock_advertisement {
+    bool read;
+    uint32_t min_interval;
+    uint32_t max_interval;
+    bool has_tx_power;
+    int16_t tx_power;
+    uint16_t duration;
+    uint16_t timeout;
+    char secondary[8];
+};
+
+/* What the mock bluetoothd in mock-bluez.c has seen so far. */
+struct mock_bluez {
+    uint64_t started;
+    uint64_t application_usec;
+    uint64_t advertisement_usec;
+    int applications;
+    int advertisements;
+    struct mock_advertisement advertisement;
+};
+
+sd_bus *
+harness_bus(void);
+
+sd_bus *
+harness_peer(void);
+
+int
+harness_seal(sd_bus_message *m);
+
+void
+harness_pump(void);
+
+struct keyboard *
+harness_keyboard(uinput fd);
+
+struct mock_bluez *
+harness_bluez(void);
+
+/* vclock.c */
+void
+vclock_install(void);
+
+uint64_t
+vclock_now(void);
+
+bool
+vclock_step(void);
+
+size_t
+vclock_advance(uint64_t usec);
@@ -0,0 +1,229 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "harness.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <errno.h>
+
+/*
+ * A minimal bluetoothd on the harness peer: one adapter, hci0, exporting
+ * Adapter1, GattManager1 and LEAdvertisingManager1 through an object
+ * manager on "/". Registrations succeed immediately and are recorded;
+ * like bluetoothd, the mock then reads the advertisement's properties.
+ */
+
+#define MOCK_ADAPTER "/org/bluez/hci0"
+
+static struct mock_bluez mock;
+
+static uint64_t
+now_usec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int
+adapter_props(sd_bus *bus, const char *path, const char *interface,
+              const char *property, sd_bus_message *reply, void *userdata,
+              sd_bus_error *ret_error)
+{
+    if (strcmp(property, "Address") == 0)
+        return sd_bus_message_append(reply, "s", "00:00:00:00:00:00");
+
+    if (strcmp(property, "Powered") == 0)
+        return sd_bus_message_append(reply, "b", true);
+
+    return -ENOENT;
+}
+
+static int
+adv_manager_props(sd_bus *bus, const char *path, const char *interface,
+                  const char *property, sd_bus_message *reply,
+                  void *userdata, sd_bus_error *ret_error)
+{
+    if (strcmp(property, "ActiveInstances") == 0)
+        return sd_bus_message_append(reply, "y", mock.advertisements > 0);
+
+    if (strcmp(property, "SupportedInstances") == 0)
+        return sd_bus_message_append(reply, "y", 4);
+
+    if (strcmp(property, "SupportedIncludes") == 0)
+        return sd_bus_message_append(reply, "as", 2, "tx-power", "local-name");
+
+    if (strcmp(property, "SupportedSecondaryChannels") == 0)
+        return sd_bus_message_append(reply, "as", 2, "1M", "2M");
+
+    if (strcmp(property, "SupportedFeatures") == 0)
+        return sd_bus_message_append(reply, "as", 1, "CanSetTxPower");
+
+    return -ENOENT;
+}
+
+static int
+adv_prop(sd_bus_message *m, const char *key)
+{
+    struct mock_advertisement *adv = &mock.advertisement;
+    const char *s = NULL;
+    int r;
+
+    if (strcmp(key, "MinInterval") == 0)
+        return sd_bus_message_read(m, "v", "u", &adv->min_interval);
+
+    if (strcmp(key, "MaxInterval") == 0)
+        return sd_bus_message_read(m, "v", "u", &adv->max_interval);
+
+    if (strcmp(key, "TxPower") == 0) {
+        adv->has_tx_power = true;
+        return sd_bus_message_read(m, "v", "n", &adv->tx_power);
+    }
+
+    if (strcmp(key, "Duration") == 0)
+        return sd_bus_message_read(m, "v", "q", &adv->duration);
+
+    if (strcmp(key, "Timeout") == 0)
+        return sd_bus_message_read(m, "v", "q", &adv->timeout);
+
+    if (strcmp(key, "SecondaryChannel") == 0) {
+        r = sd_bus_message_read(m, "v", "s", &s);
+        if (r >= 0)
+            snprintf(adv->secondary, sizeof(adv->secondary), "%s", s);
+        return r;
+    }
+
+    return sd_bus_message_skip(m, "v");
+}
+
+static int
+on_adv_props(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    int r;
+
+    mock.advertisement = (struct mock_advertisement) {};
+    if (sd_bus_message_is_method_error(m, NULL))
+        return 0;
+
+    r = sd_bus_message_enter_container(m, 'a', "{sv}");
+    while (r >= 0 && (r = sd_bus_message_enter_container(m, 'e', "sv")) > 0) {
+        const char *key = NULL;
+
+        r = sd_bus_message_read(m, "s", &key);
+        if (r >= 0)
+            r = adv_prop(m, key);
+        if (r >= 0)
+            r = sd_bus_message_exit_container(m);
+    }
+
+    mock.advertisement.read = r >= 0;
+    return 0;
+}
+
+static int
+on_register(sd_bus_message *m, void *misc, sd_bus_error *err)
+{
+    const char *member = sd_bus_message_get_member(m);
+    const char *path = NULL;
+
+    if (strcmp(member, "RegisterApplication") == 0) {
+        mock.applications++;
+        mock.application_usec = now_usec();
+    } else {
+        mock.advertisements++;
+        mock.advertisement_usec = now_usec();
+
+        if (sd_bus_message_read(m, "o", &path) < 0 ||
+            sd_bus_call_method_async(sd_bus_message_get_bus(m), NULL, NULL,
+                                     path,
+                                     "org.freedesktop.DBus.Properties",
+                                     "GetAll", on_adv_props, NULL, "s",
+                                     "org.bluez.LEAdvertisement1") < 0)
+            abort();
+    }
+
+    return sd_bus_reply_method_return(m, "");
+}
+
+static int
+on_unregister(sd_bus_message *m, void *misc, sd_bus_error *err)
+{
+    const char *member = sd_bus_message_get_member(m);
+
+    if (strcmp(member, "UnregisterApplication") == 0)
+        mock.applications--;
+    else
+        mock.advertisements--;
+
+    return sd_bus_reply_method_return(m, "");
+}
+
+static const sd_bus_vtable adapter_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    SD_BUS_PROPERTY("Address", "s", adapter_props, 0, 0),
+    SD_BUS_PROPERTY("Powered", "b", adapter_props, 0, 0),
+    SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable gatt_manager_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    SD_BUS_METHOD("RegisterApplication", "oa{sv}", "", on_register, 0),
+    SD_BUS_METHOD("UnregisterApplication", "o", "", on_unregister, 0),
+    SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable adv_manager_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    SD_BUS_PROPERTY("ActiveInstances", "y", adv_manager_props, 0, 0),
+    SD_BUS_PROPERTY("SupportedInstances", "y", adv_manager_props, 0, 0),
+    SD_BUS_PROPERTY("SupportedIncludes", "as", adv_manager_props, 0, 0),
+    SD_BUS_PROPERTY("SupportedSecondaryChannels", "as", adv_manager_props,
+                    0, 0),
+    SD_BUS_PROPERTY("SupportedFeatures", "as", adv_manager_props, 0, 0),
+    SD_BUS_METHOD("RegisterAdvertisement", "oa{sv}", "", on_register, 0),
+    SD_BUS_METHOD("UnregisterAdvertisement", "o", "", on_unregister, 0),
+    SD_BUS_VTABLE_END
+};
+
+struct mock_bluez *
+harness_bluez(void)
+{
+    sd_bus *peer = harness_peer();
+
+    if (mock.started)
+        return &mock;
+
+    if (sd_bus_add_object_manager(peer, NULL, "/") < 0 ||
+        sd_bus_add_object_vtable(peer, NULL, MOCK_ADAPTER,
+                                 "org.bluez.Adapter1",
+                                 adapter_vtable, NULL) < 0 ||
+        sd_bus_add_object_vtable(peer, NULL, MOCK_ADAPTER,
+                                 "org.bluez.GattManager1",
+                                 gatt_manager_vtable, NULL) < 0 ||
+        sd_bus_add_object_vtable(peer, NULL, MOCK_ADAPTER,
+                                 "org.bluez.LEAdvertisingManager1",
+                                 adv_manager_vtable, NULL) < 0)
+        abort();
+
+    mock.started = now_usec();
+    return &mock;
+}
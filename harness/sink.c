@@ -0,0 +1,79 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "harness.h"
+
+#include <stdlib.h>
+
+#include <errno.h>
+
+/*
+ * Stands in for uinput.c: the device always opens (as SINK_FD), key events
+ * are accepted without writing anything, and it crashes if the handler
+ * ever tries to type a key that the real device would not have registered.
+ */
+void
+uinput_cleanup(uinput *i)
+{
+}
+
+int
+uinput_open(uinput *input)
+{
+    *input = SINK_FD;
+    return 0;
+}
+
+int
+event(uinput input, uint16_t k, bool down)
+{
+    switch (k) {
+    case KEY_1 ... KEY_0:
+    case KEY_ENTER:
+    case KEY_UNKNOWN:
+        return 0;
+    default:
+        abort();
+    }
+}
+
+#ifdef JELLING_IO_URING
+/* Typing always falls back to event() above. */
+int
+uring_fd(void)
+{
+    return -EOPNOTSUPP;
+}
+
+int
+uring_submit(uinput input, const uint8_t *bytes, size_t size, bool enter)
+{
+    return -EOPNOTSUPP;
+}
+
+int
+uring_reap(void)
+{
+    return -EOPNOTSUPP;
+}
+
+int
+uring_cancel(void)
+{
+    return -EOPNOTSUPP;
+}
+#endif
@@ -0,0 +1,135 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "harness.h"
+
+#include <errno.h>
+
+/*
+ * Virtual time for timer.c. Nothing ever waits: armed timers fire only
+ * when the harness steps or advances the clock, which jumps straight to
+ * each deadline in turn (ties fire in the order they were armed).
+ */
+
+#define VCLOCK_TIMERS 64
+
+struct armed {
+    struct timer *timer;
+    uint64_t when;
+    uint64_t seq;
+};
+
+static struct armed armed[VCLOCK_TIMERS];
+static size_t narmed;
+static uint64_t seq;
+static uint64_t now = 1000000;
+
+static uint64_t
+vclock_time(sd_event *event)
+{
+    return now;
+}
+
+static void
+vclock_stop(struct timer *t)
+{
+    for (size_t i = 0; i < narmed; i++) {
+        if (armed[i].timer == t) {
+            armed[i] = armed[--narmed];
+            return;
+        }
+    }
+}
+
+static int
+vclock_start(struct timer *t, sd_event *event, uint64_t delay)
+{
+    vclock_stop(t);
+    if (narmed == VCLOCK_TIMERS)
+        return -ENOBUFS;
+
+    armed[narmed++] = (struct armed) { t, now + delay, seq++ };
+    return 0;
+}
+
+static const struct clock vclock = {
+    .now = vclock_time,
+    .start = vclock_start,
+    .stop = vclock_stop,
+};
+
+void
+vclock_install(void)
+{
+    timebase = &vclock;
+}
+
+uint64_t
+vclock_now(void)
+{
+    return now;
+}
+
+/* Returns the index of the next timer to fire, or narmed if none is. */
+static size_t
+next(void)
+{
+    size_t n = narmed;
+
+    for (size_t i = 0; i < narmed; i++) {
+        if (n == narmed || armed[i].when < armed[n].when ||
+            (armed[i].when == armed[n].when && armed[i].seq < armed[n].seq))
+            n = i;
+    }
+
+    return n;
+}
+
+bool
+vclock_step(void)
+{
+    size_t n = next();
+    struct armed a;
+
+    if (n == narmed)
+        return false;
+
+    a = armed[n];
+    armed[n] = armed[--narmed];
+    if (a.when > now)
+        now = a.when;
+
+    a.timer->handler(NULL, a.when, a.timer->userdata);
+    return true;
+}
+
+size_t
+vclock_advance(uint64_t usec)
+{
+    uint64_t end = now + usec;
+    size_t fired = 0;
+
+    for (size_t n = next(); n < narmed && armed[n].when <= end; n = next()) {
+        vclock_step();
+        fired++;
+    }
+
+    if (now < end)
+        now = end;
+
+    return fired;
+}
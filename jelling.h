@@ -0,0 +1,574 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Authors: Nathaniel McCallum <npmccallum@redhat.com>
+ *
+ * Copyright (C) 2015  Nathaniel McCallum, Red Hat
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <linux/input.h>
+#include <systemd/sd-bus.h>
+#include <systemd/sd-event.h>
+
+#define MAN_PATH "/"
+#define ADV_PATH "/adv"
+#define SVC_PATH "/svc"
+#define CHR_PATH "/svc/chr"
+#define CAP_PATH "/svc/cap"
+#define SVC_UUID "B670003C-0079-465C-9BA7-6C0539CCD67F"
+#define CHR_UUID "F4186B06-D796-4327-AF39-AC22C50BDCA8"
+#define CAP_UUID "FEF80356-9BBF-46D7-AA87-4C37A72BC32D"
+#define STATS_PATH "/stats"
+#define BUS_NAME "org.freeotp.Jelling"
+#define CTL_IFACE "org.freeotp.Jelling.Advertising1"
+
+#define OTP_MAX 32
+#define PENDING_MAX 8
+#define DEVICE_MAX 64
+#define ADAPTER_MAX 4
+
+/* Leaves the advertising TX power to bluez. */
+#define ADV_TX_POWER_UNSET INT16_MIN
+#define DEDUP_MAX 16
+#define BUCKET_MAX 16
+#define ASSEMBLY_MAX 4
+
+/* ATT's limit on the length of an attribute value. */
+#define VALUE_MAX 512
+
+/* How long each key transition is held before the next one. */
+#define PACE_USEC 50000ULL
+
+#define COUNT(array) (sizeof(array) / sizeof(*array))
+
+#define SCOPED(type) \
+    __attribute__((cleanup(type ## _cleanup))) type
+
+#define PROP(name, sig, func) \
+    SD_BUS_PROPERTY(name, sig, func, 0, SD_BUS_VTABLE_PROPERTY_CONST)
+
+#define METH(name, sig, rsig, func) \
+    SD_BUS_METHOD(name, sig, rsig, func, SD_BUS_VTABLE_UNPRIVILEGED)
+
+typedef int uinput;
+
+enum startup_phase {
+    STARTUP_MAIN = 0,
+    STARTUP_BUS,
+    STARTUP_QUERY,
+    STARTUP_UINPUT,
+    STARTUP_OBJECTS,
+    STARTUP_ADAPTERS,
+    STARTUP_APPLICATION,
+    STARTUP_ADVERTISING,
+    STARTUP_PHASES
+};
+
+/* What to do with a write that arrives while the queue is full. */
+enum queue_full {
+    QUEUE_FULL_REJECT = 0,
+    QUEUE_FULL_DROP_OLDEST,
+    QUEUE_FULL_BLOCK,
+};
+
+/* When to advertise, going by the session on our seat; see session.c. */
+enum adv_when {
+    ADV_WHEN_ALWAYS = 0,
+    ADV_WHEN_UNLOCKED,
+    ADV_WHEN_PRESENT,
+};
+
+/* Command line options; see config.c. */
+struct config {
+    size_t queue_depth;
+    enum queue_full queue_full;
+    bool supersede;
+    uint64_t dedup_window;
+    uint64_t rate_interval;
+    uint64_t rate_burst;
+    uint32_t adv_min_interval;
+    uint32_t adv_max_interval;
+    int16_t adv_tx_power;
+    uint16_t adv_duration;
+    uint16_t adv_timeout;
+    const char *adv_secondary;
+    uint32_t adv_burst_min;
+    uint32_t adv_burst_max;
+    uint64_t adv_burst_usec;
+    bool adv_tag;
+    const char *seat;
+    enum adv_when adv_when;
+    bool disconnect;
+    uint64_t connection_slots;
+    uint32_t conn_min_interval;
+    uint32_t conn_max_interval;
+};
+
+extern struct config config;
+
+/* A one-shot timer; see timer.c for the slack policy. */
+struct timer {
+    sd_event_source *source;
+    sd_event_time_handler_t handler;
+    void *userdata;
+    bool precise;
+};
+
+/*
+ * The daemon's sense of time. Normally sd-event (timer.c); the harness
+ * swaps in a virtual clock so that timing can be checked without waiting
+ * for it.
+ */
+struct clock {
+    uint64_t (*now)(sd_event *event);
+    int (*start)(struct timer *t, sd_event *event, uint64_t delay);
+    void (*stop)(struct timer *t);
+};
+
+extern const struct clock *timebase;
+
+/* One code of a written value; bytes point into the value. See frame.c. */
+struct record {
+    const uint8_t *bytes;
+    size_t size;
+    bool enter;
+};
+
+/*
+ * A validated code waiting to be typed. The WriteValue reply is sent when
+ * the code is accepted into the queue; call holds it back while the code
+ * is blocked behind a full queue (for a batch, on its last code). A
+ * superseded code has been cut short: size no longer counts the keys it
+ * will not type, and Enter is skipped.
+ */
+struct otp {
+    sd_bus_message *call;
+    uint64_t queued;
+    bool enter;
+    bool superseded;
+    char device[DEVICE_MAX];
+    size_t size;
+    uint8_t bytes[OTP_MAX];
+};
+
+/*
+ * Writes accepted within the last window microseconds, remembered by a
+ * keyed MAC of device and payload rather than the payload itself; see
+ * dedup.c. A zero window disables suppression.
+ */
+struct dedup_entry {
+    uint64_t mac;
+    uint64_t at;
+    bool used;
+};
+
+struct dedup {
+    uint8_t key[16];
+    uint64_t window;
+    size_t next;
+    struct dedup_entry entries[DEDUP_MAX];
+};
+
+/*
+ * Per-device token buckets: a write takes a token, one token comes back
+ * every interval microseconds and at most burst are held. A zero interval
+ * disables limiting; see ratelimit.c.
+ */
+struct bucket {
+    char device[DEVICE_MAX];
+    uint64_t credit;
+    uint64_t at;
+    bool used;
+};
+
+struct ratelimit {
+    uint64_t interval;
+    uint64_t burst;
+    struct bucket buckets[BUCKET_MAX];
+};
+
+/* The WriteValue options Jelling reads; strings point into the message. */
+struct write_options {
+    const char *device;
+    const char *link;
+    uint16_t offset;
+    uint16_t mtu;
+    bool prepared;
+    bool authorize;
+};
+
+/* A long write being put back together from its chunks; see longwrite.c. */
+struct assembly {
+    struct timer flush;
+    struct keyboard *kbd;
+    bool used;
+    char device[DEVICE_MAX];
+    size_t size;
+    uint8_t bytes[VALUE_MAX];
+};
+
+/*
+ * The uinput device and the queue of codes to type on it. Codes are typed
+ * one key transition per pace timer expiry (or as one io_uring chain), so
+ * writes keep being accepted while a code is typed. The first depth codes
+ * in the ring are accepted; with the block policy, more wait behind them.
+ * While the device is being recreated, codes stay queued.
+ */
+struct keyboard {
+    uinput fd;
+    sd_event *event;
+    sd_event_source *uring;
+    struct timer retry;
+    struct timer pace;
+    uint64_t backoff;
+    uint64_t down_since;
+    size_t depth;
+    enum queue_full full;
+    bool supersede;
+    bool typing;
+    bool chained;
+    size_t step;
+    size_t head;
+    size_t count;
+    struct otp pending[PENDING_MAX];
+    struct dedup dedup;
+    struct ratelimit limits;
+    struct assembly assemblies[ASSEMBLY_MAX];
+};
+
+/* An object of the GATT application, with the data its vtable reads. */
+struct gatt_object {
+    const char *path;
+    const char *interface;
+    const sd_bus_vtable *vtable;
+    const void *data;
+};
+
+/*
+ * Durations in power-of-two buckets of milliseconds: bucket 0 holds those
+ * under 1 ms and bucket i those from 2^(i-1) ms up to 2^i ms, with the last
+ * taking everything longer.
+ */
+#define HISTOGRAM_BUCKETS 16
+
+struct histogram {
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+/* Counters exported read-only on STATS_PATH. */
+struct stats {
+    uint64_t uinput_failures;
+    uint64_t uinput_recreations;
+    uint64_t uinput_recreate_last_usec;
+    uint64_t uinput_recreate_max_usec;
+    uint64_t uinput_recreate_total_usec;
+    uint64_t pending_expired;
+    uint64_t queue_rejected;
+    uint64_t queue_dropped;
+    uint64_t superseded;
+    uint64_t duplicates_suppressed;
+    uint64_t rate_limited;
+    uint64_t adv_bursts;
+    uint64_t adv_fast_usec;
+    uint64_t adv_slow_usec;
+    uint64_t adv_paused_usec;
+    uint64_t discovery_last_usec;
+    uint64_t discovery_max_usec;
+    uint64_t connect_write_last_usec;
+    uint64_t connect_write_max_usec;
+    uint64_t disconnects;
+    char adapters[ADAPTER_MAX][DEVICE_MAX];
+    uint64_t connections[ADAPTER_MAX];
+    uint64_t connections_max[ADAPTER_MAX];
+    uint64_t slots_exhausted[ADAPTER_MAX];
+    struct histogram resolve_hist;
+    struct histogram pair_hist;
+    struct histogram write_hist;
+    struct histogram type_hist;
+    struct histogram connected_hist;
+    uint64_t wakeups;
+    uint64_t timer_wakeups;
+};
+
+extern struct stats stats;
+
+static inline void
+sd_bus_message_cleanup(sd_bus_message **msg)
+{
+    if (msg == NULL || *msg == NULL)
+        return;
+
+    sd_bus_message_unref(*msg);
+}
+
+static inline void
+sd_bus_cleanup(sd_bus **bus)
+{
+    if (bus == NULL || *bus == NULL)
+        return;
+
+    sd_bus_unref(*bus);
+}
+
+static inline void
+sd_event_cleanup(sd_event **event)
+{
+    if (event == NULL || *event == NULL)
+        return;
+
+    sd_event_unref(*event);
+}
+
+static inline uint16_t
+char2key(uint8_t c)
+{
+    switch (c) {
+    case '0': return KEY_0;
+    case '1': return KEY_1;
+    case '2': return KEY_2;
+    case '3': return KEY_3;
+    case '4': return KEY_4;
+    case '5': return KEY_5;
+    case '6': return KEY_6;
+    case '7': return KEY_7;
+    case '8': return KEY_8;
+    case '9': return KEY_9;
+    default: return KEY_UNKNOWN;
+    }
+}
+
+/*
+ * Fills evts with the frame that reports one key transition and returns
+ * the number of events in it. KEY_UNKNOWN yields a bare EV_SYN.
+ */
+static inline size_t
+event_frame(struct input_event evts[2], uint16_t k, bool down)
+{
+    evts[0] = (struct input_event) { .type = EV_SYN };
+    if (k == KEY_UNKNOWN)
+        return 1;
+
+    evts[1] = (struct input_event) {
+        .type = EV_KEY, .code = k, .value = down
+    };
+    return 2;
+}
+
+/* uinput.c */
+void
+uinput_cleanup(uinput *i);
+
+int
+event(uinput input, uint16_t k, bool down);
+
+int
+uinput_open(uinput *input);
+
+/* uring.c, built with -Dio_uring=true */
+int
+uring_fd(void);
+
+int
+uring_submit(uinput input, const uint8_t *bytes, size_t size, bool enter);
+
+int
+uring_reap(void);
+
+int
+uring_cancel(void);
+
+/* dedup.c */
+uint64_t
+siphash24(const uint8_t key[16], const uint8_t *in, size_t len);
+
+void
+dedup_init(struct dedup *d, uint64_t window);
+
+uint64_t
+dedup_mac(const struct dedup *d, const char *device,
+          const struct record *records, size_t n);
+
+bool
+dedup_seen(const struct dedup *d, uint64_t mac, uint64_t now);
+
+void
+dedup_add(struct dedup *d, uint64_t mac, uint64_t now);
+
+/* ratelimit.c */
+void
+ratelimit_init(struct ratelimit *rl, uint64_t interval, uint64_t burst);
+
+bool
+ratelimit_take(struct ratelimit *rl, const char *device, uint64_t now,
+               uint64_t cost);
+
+bool
+ratelimit_check(const struct ratelimit *rl, const char *device, uint64_t now,
+                uint64_t cost);
+
+/* frame.c */
+int
+frame_parse(const uint8_t *value, size_t size, struct record *records);
+
+int
+frame_prefix(const uint8_t *value, size_t size, struct record *records);
+
+/* longwrite.c */
+void
+longwrite_init(struct keyboard *kbd);
+
+void
+longwrite_cleanup(struct keyboard *kbd);
+
+size_t
+longwrite_chunk(const struct write_options *opts);
+
+int
+longwrite(struct keyboard *kbd, sd_bus_message *call,
+          const struct write_options *opts, const uint8_t *bytes, size_t size);
+
+/* keyboard.c */
+void
+keyboard_attach(struct keyboard *kbd, sd_event *event, uinput fd);
+
+int
+keyboard_init(struct keyboard *kbd, sd_event *event);
+
+void
+keyboard_cleanup(struct keyboard *kbd);
+
+int
+keyboard_type(struct keyboard *kbd, sd_bus_message *call, const char *device,
+              const struct record *records, size_t n);
+
+int
+keyboard_check(struct keyboard *kbd, const char *device, size_t n);
+
+/* timer.c */
+uint64_t
+timer_now(sd_event *event);
+
+int
+timer_start(struct timer *t, sd_event *event, uint64_t delay);
+
+void
+timer_stop(struct timer *t);
+
+void
+timer_cleanup(struct timer *t);
+
+/* config.c */
+void
+setup_config(int argc, char *argv[]);
+
+/* stats.c */
+void
+histogram_add(struct histogram *h, uint64_t usec);
+
+void
+setup_stats(sd_bus *bus, sd_event *event);
+
+/* advertising.c */
+extern const sd_bus_vtable adv_vtable[];
+
+void
+advertising_burst(const char *why);
+
+void
+advertising_seen(const char *device);
+
+int
+advertising_check(sd_bus_message *m);
+
+void
+advertising_add(sd_bus *bus, const char *adapter);
+
+void
+advertising_allow(bool allowed);
+
+void
+advertising_disconnected(const char *path);
+
+void
+setup_advertising(sd_bus *bus, sd_event *event);
+
+/* connection.c */
+void
+connection_write(const char *device);
+
+void
+connection_typed(const char *device);
+
+int
+connection_check(sd_bus_message *m, const char *device);
+
+void
+setup_connections(sd_bus *bus, sd_event *event);
+
+/* connparam.c */
+void
+connparam_written(const char *device);
+
+void
+connparam_typed(const char *device);
+
+void
+connparam_disconnected(const char *device);
+
+void
+setup_connparam(sd_bus *bus, sd_event *event);
+
+/* gatt.c */
+extern const sd_bus_vtable svc_vtable[];
+extern const sd_bus_vtable chr_vtable[];
+extern const struct gatt_object gatt_objects[];
+
+int
+chr_writevalue(sd_bus_message *m, void *misc, sd_bus_error *err);
+
+void
+gatt_fixed_handles(bool on);
+
+void
+setup_objects(sd_bus *bus, struct keyboard *kbd);
+
+/* session.c */
+void
+setup_session(sd_bus *bus);
+
+/* startup.c */
+void
+startup_mark(enum startup_phase phase);
+
+void
+setup_daemon(sd_bus *bus, sd_event *event, struct keyboard *kbd);
+
+/* bluez.c */
+bool
+bluez_registered(const char *path);
+
+int
+on_bt_iface(sd_bus_message *m, void *bus, sd_bus_error *ret_error);
+
+int
+on_bt_objects(sd_bus_message *m, void *bus, sd_bus_error *ret_error);
+
+void
+setup_registration(sd_bus *bus);
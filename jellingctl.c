@@ -0,0 +1,63 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <error.h>
+
+/* Asks the running daemon to do something; see usage(). */
+
+static void
+usage(const char *prog, int status)
+{
+    fprintf(status == EXIT_SUCCESS ? stdout : stderr,
+            "Usage: %s COMMAND\n"
+            "  burst    advertise fast for a while, so a phone finds this "
+            "computer sooner\n",
+            prog);
+    exit(status);
+}
+
+int
+main(int argc, char *argv[])
+{
+    SCOPED(sd_bus_message) *reply = NULL;
+    sd_bus_error err = SD_BUS_ERROR_NULL;
+    SCOPED(sd_bus) *bus = NULL;
+    int r;
+
+    if (argc == 2 && strcmp(argv[1], "--help") == 0)
+        usage(argv[0], EXIT_SUCCESS);
+    if (argc != 2 || strcmp(argv[1], "burst") != 0)
+        usage(argv[0], EXIT_FAILURE);
+
+    r = sd_bus_default_system(&bus);
+    if (r < 0)
+        error(EXIT_FAILURE, -r, "Error connecting to system bus");
+
+    r = sd_bus_call_method(bus, BUS_NAME, ADV_PATH, CTL_IFACE, "Burst", &err,
+                           &reply, "");
+    if (r < 0)
+        error(EXIT_FAILURE, -r, "Error asking Jelling to advertise: %s",
+              err.message ? err.message : strerror(-r));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,603 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <errno.h>
+
+#include <sys/epoll.h>
+
+#define RETRY_MIN_USEC 100000ULL
+#define RETRY_MAX_USEC 5000000ULL
+
+/*
+ * Stay under the 25 s bluetoothd waits for a blocked write's reply; codes
+ * that waited this long for the device are stale anyway.
+ */
+#define PENDING_TIMEOUT_USEC 20000000ULL
+
+static void
+start(struct keyboard *kbd);
+
+static struct otp *
+at(struct keyboard *kbd, size_t i)
+{
+    return &kbd->pending[(kbd->head + i) % PENDING_MAX];
+}
+
+static size_t
+keys(const struct otp *otp)
+{
+    return otp->size + (otp->enter && !otp->superseded);
+}
+
+/* Each key goes down then up, then Enter if asked for, then a bare EV_SYN. */
+static size_t
+steps(const struct otp *otp)
+{
+    return 2 * keys(otp) + 1;
+}
+
+static uint16_t
+transition(const struct otp *otp, size_t step, bool *down)
+{
+    *down = step % 2 == 0;
+    if (step >= 2 * keys(otp)) {
+        *down = false;
+        return KEY_UNKNOWN;
+    }
+
+    return step / 2 < otp->size ? char2key(otp->bytes[step / 2]) : KEY_ENTER;
+}
+
+/* Answers the blocked writes whose codes now fit in the queue. */
+static void
+admit(struct keyboard *kbd)
+{
+    for (size_t i = 0; i < kbd->count && i < kbd->depth; i++) {
+        struct otp *otp = at(kbd, i);
+
+        if (!otp->call)
+            continue;
+
+        sd_bus_reply_method_return(otp->call, "");
+        otp->call = sd_bus_message_unref(otp->call);
+    }
+}
+
+/* Removes the i-th code, answering its write if that is still owed. */
+static void
+finish(struct keyboard *kbd, size_t i, int r)
+{
+    struct otp *otp = at(kbd, i);
+
+    if (otp->call && r == -ECANCELED) {
+        sd_bus_reply_method_errorf(otp->call, "org.bluez.Error.Failed",
+                                   "Superseded");
+    } else if (otp->call && r < 0) {
+        sd_bus_reply_method_errorf(otp->call, "org.bluez.Error.Failed",
+                                   "Write failed");
+    } else if (otp->call) {
+        sd_bus_reply_method_return(otp->call, "");
+    }
+    sd_bus_message_unref(otp->call);
+
+    if (i == 0) {
+        *otp = (struct otp) {};
+        kbd->head = (kbd->head + 1) % PENDING_MAX;
+    } else {
+        for (; i + 1 < kbd->count; i++)
+            *at(kbd, i) = *at(kbd, i + 1);
+        *at(kbd, i) = (struct otp) {};
+    }
+
+    kbd->count--;
+}
+
+/* Queues the codes of one write; a blocked write is answered with its last. */
+static void
+enqueue(struct keyboard *kbd, sd_bus_message *call, const char *device,
+        const struct record *records, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        struct otp *otp = at(kbd, kbd->count++);
+
+        otp->call = i + 1 == n ? sd_bus_message_ref(call) : NULL;
+        otp->queued = timer_now(kbd->event);
+        snprintf(otp->device, sizeof(otp->device), "%s", device);
+        otp->enter = records[i].enter;
+        otp->size = records[i].size;
+        memcpy(otp->bytes, records[i].bytes, records[i].size);
+    }
+}
+
+static void
+schedule(struct keyboard *kbd, uint64_t delay)
+{
+    int r;
+
+    r = timer_start(&kbd->retry, kbd->event, delay);
+    if (r < 0)
+        fprintf(stderr, "Error scheduling uinput recreation: %s\n",
+                strerror(-r));
+}
+
+/*
+ * Drops the device and starts recreating it in the background. The code
+ * being typed stays at the head of the queue and is retyped in full once
+ * the device is back: the keys written so far went to a device that no
+ * longer exists.
+ */
+static void
+lost(struct keyboard *kbd, int err)
+{
+    stats.uinput_failures++;
+    fprintf(stderr, "Error writing to uinput: %s; recreating device\n",
+            strerror(-err));
+
+    timer_stop(&kbd->pace);
+    kbd->typing = false;
+    kbd->chained = false;
+    kbd->step = 0;
+
+    uinput_cleanup(&kbd->fd);
+    kbd->fd = -1;
+    kbd->down_since = timer_now(kbd->event);
+    kbd->backoff = RETRY_MIN_USEC;
+    schedule(kbd, 0);
+}
+
+/* Whether a code from device is still queued or being put together. */
+static bool
+queued(struct keyboard *kbd, const char *device)
+{
+    for (size_t i = 0; i < kbd->count; i++) {
+        if (strcmp(at(kbd, i)->device, device) == 0)
+            return true;
+    }
+
+    for (size_t i = 0; i < ASSEMBLY_MAX; i++) {
+        const struct assembly *a = &kbd->assemblies[i];
+
+        if (a->used && strcmp(a->device, device) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+/* The head code has been typed: move on to the next one. */
+static void
+done(struct keyboard *kbd)
+{
+    char device[DEVICE_MAX];
+
+    memcpy(device, at(kbd, 0)->device, sizeof(device));
+
+    kbd->typing = false;
+    kbd->chained = false;
+    kbd->step = 0;
+    finish(kbd, 0, 0);
+    admit(kbd);
+
+    if (!queued(kbd, device))
+        connection_typed(device);
+
+    start(kbd);
+}
+
+/* Writes the next transition of the head code and paces the one after. */
+static void
+advance(struct keyboard *kbd)
+{
+    struct otp *otp = at(kbd, 0);
+    uint16_t k;
+    bool down;
+    int r;
+
+    if (kbd->step == steps(otp)) {
+        done(kbd);
+        return;
+    }
+
+    k = transition(otp, kbd->step, &down);
+    r = event(kbd->fd, k, down);
+    if (r < 0) {
+        lost(kbd, r);
+        return;
+    }
+
+    kbd->step++;
+    r = timer_start(&kbd->pace, kbd->event, PACE_USEC);
+    if (r < 0) {
+        fprintf(stderr, "Error pacing keys: %s\n", strerror(-r));
+        lost(kbd, r);
+    }
+}
+
+static int
+on_pace(sd_event_source *s, uint64_t usec, void *misc)
+{
+    advance(misc);
+    return 0;
+}
+
+#ifdef JELLING_IO_URING
+/*
+ * Where a canceled chain stopped is unknown, so every key of the code is
+ * released. The kernel drops releases of keys that are not down.
+ */
+static void
+release(struct keyboard *kbd)
+{
+    struct otp *otp = at(kbd, 0);
+
+    for (size_t i = 0; i < otp->size; i++)
+        event(kbd->fd, char2key(otp->bytes[i]), false);
+
+    event(kbd->fd, KEY_ENTER, false);
+    event(kbd->fd, KEY_UNKNOWN, false);
+}
+
+static int
+on_uring(sd_event_source *s, int fd, uint32_t revents, void *misc)
+{
+    struct keyboard *kbd = misc;
+    int r;
+
+    r = uring_reap();
+    if (r == -EAGAIN)
+        return 0;
+
+    if (r == -ECANCELED && at(kbd, 0)->superseded)
+        release(kbd);
+    else if (r < 0) {
+        lost(kbd, r);
+        return 0;
+    }
+
+    done(kbd);
+    return 0;
+}
+
+/* Hands the whole head code to the kernel if the io_uring engine works. */
+static bool
+submit(struct keyboard *kbd)
+{
+    struct otp *otp = at(kbd, 0);
+    int r;
+
+    if (!kbd->uring && kbd->event && uring_fd() >= 0) {
+        r = sd_event_add_io(kbd->event, &kbd->uring, uring_fd(), EPOLLIN,
+                            on_uring, kbd);
+        if (r < 0)
+            kbd->uring = NULL;
+    }
+
+    if (!kbd->uring)
+        return false;
+
+    r = uring_submit(kbd->fd, otp->bytes, otp->size, otp->enter);
+    if (r == -EOPNOTSUPP) {
+        kbd->uring = sd_event_source_unref(kbd->uring);
+        return false;
+    }
+
+    kbd->chained = r >= 0;
+    if (r < 0)
+        lost(kbd, r);
+
+    return true;
+}
+#endif
+
+/*
+ * Stops the code being typed after the key it is on, releasing that key
+ * and skipping Enter. Once Enter has been pressed it is too late.
+ */
+static bool
+cancel(struct keyboard *kbd)
+{
+    struct otp *otp = at(kbd, 0);
+    size_t started = (kbd->step + 1) / 2;
+
+#ifdef JELLING_IO_URING
+    if (kbd->chained) {
+        if (uring_cancel() < 0)
+            return false;
+
+        otp->superseded = true;
+        return true;
+    }
+#endif
+
+    if (started > otp->size)
+        return false;
+
+    otp->size = started;
+    otp->superseded = true;
+    return true;
+}
+
+/*
+ * A newer code from the same device makes its older ones stale: queued
+ * codes are dropped and the one being typed is cut short.
+ */
+static void
+supersede(struct keyboard *kbd, const char *device)
+{
+    for (size_t i = kbd->count; i-- > 0; ) {
+        struct otp *otp = at(kbd, i);
+
+        if (otp->superseded || strcmp(otp->device, device) != 0)
+            continue;
+
+        if (i == 0 && kbd->typing) {
+            if (!cancel(kbd))
+                continue;
+        } else {
+            finish(kbd, i, -ECANCELED);
+        }
+
+        stats.superseded++;
+        fprintf(stderr, "Superseded a code from %s\n",
+                device[0] ? device : "an unknown device");
+    }
+
+    admit(kbd);
+}
+
+static void
+start(struct keyboard *kbd)
+{
+    if (kbd->typing || kbd->count == 0 || kbd->fd < 0)
+        return;
+
+    kbd->typing = true;
+    kbd->step = 0;
+
+#ifdef JELLING_IO_URING
+    if (submit(kbd))
+        return;
+#endif
+
+    advance(kbd);
+}
+
+/* Drops codes that have waited too long for the device to come back. */
+static void
+expire(struct keyboard *kbd, uint64_t usec)
+{
+    while (kbd->count > 0 && !kbd->typing) {
+        struct otp *otp = at(kbd, 0);
+
+        if (otp->queued + PENDING_TIMEOUT_USEC > usec)
+            break;
+
+        stats.pending_expired++;
+        finish(kbd, 0, -ETIMEDOUT);
+        admit(kbd);
+    }
+}
+
+static int
+on_retry(sd_event_source *s, uint64_t usec, void *misc)
+{
+    struct keyboard *kbd = misc;
+    uint64_t down;
+    int r;
+
+    r = uinput_open(&kbd->fd);
+    if (r < 0) {
+        expire(kbd, usec);
+        kbd->backoff *= 2;
+        if (kbd->backoff > RETRY_MAX_USEC)
+            kbd->backoff = RETRY_MAX_USEC;
+        schedule(kbd, kbd->backoff);
+        return 0;
+    }
+
+    down = usec - kbd->down_since;
+    stats.uinput_recreations++;
+    stats.uinput_recreate_last_usec = down;
+    stats.uinput_recreate_total_usec += down;
+    if (down > stats.uinput_recreate_max_usec)
+        stats.uinput_recreate_max_usec = down;
+
+    fprintf(stderr, "Recreated uinput device after %.1f ms\n", down / 1000.0);
+    startup_mark(STARTUP_UINPUT);
+    start(kbd);
+    return 0;
+}
+
+/* Sets kbd up around fd, which may be -1 until a device is open. */
+void
+keyboard_attach(struct keyboard *kbd, sd_event *event, uinput fd)
+{
+    *kbd = (struct keyboard) {
+        .fd = fd,
+        .event = event,
+        .retry = { .handler = on_retry, .userdata = kbd },
+        .pace = { .handler = on_pace, .userdata = kbd, .precise = true },
+        .depth = config.queue_depth,
+        .full = config.queue_full,
+        .supersede = config.supersede,
+    };
+
+    dedup_init(&kbd->dedup, config.dedup_window);
+    ratelimit_init(&kbd->limits, config.rate_interval, config.rate_burst);
+    longwrite_init(kbd);
+}
+
+int
+keyboard_init(struct keyboard *kbd, sd_event *event)
+{
+    int r;
+
+    keyboard_attach(kbd, event, -1);
+
+    r = uinput_open(&kbd->fd);
+    if (r >= 0) {
+        startup_mark(STARTUP_UINPUT);
+        return 0;
+    }
+
+    /* Not fatal: codes queue up until the device can be created. */
+    fprintf(stderr, "Error creating uinput device: %s; retrying\n",
+            strerror(-r));
+    kbd->down_since = timer_now(kbd->event);
+    kbd->backoff = RETRY_MIN_USEC;
+    schedule(kbd, kbd->backoff);
+    return r;
+}
+
+void
+keyboard_cleanup(struct keyboard *kbd)
+{
+    if (kbd == NULL)
+        return;
+
+    longwrite_cleanup(kbd);
+    while (kbd->count > 0)
+        finish(kbd, 0, -ESHUTDOWN);
+
+    timer_cleanup(&kbd->pace);
+    timer_cleanup(&kbd->retry);
+    kbd->uring = sd_event_source_unref(kbd->uring);
+    uinput_cleanup(&kbd->fd);
+    kbd->fd = -1;
+}
+
+/*
+ * A batch larger than the rate limit's burst could never be let through,
+ * so it is refused as too long rather than rate limited.
+ */
+static bool
+oversized(const struct keyboard *kbd, size_t n)
+{
+    return kbd->limits.interval > 0 && n > kbd->limits.burst;
+}
+
+/*
+ * Queues the validated codes of one write, all of them or none. Returns 1
+ * if they were accepted and the write can be answered now, 0 if some are
+ * blocked behind a full queue and the reply will be sent once they are
+ * accepted, or a negative errno if the write was rejected.
+ */
+int
+keyboard_type(struct keyboard *kbd, sd_bus_message *call, const char *device,
+              const struct record *records, size_t n)
+{
+    size_t oldest = kbd->typing ? 1 : 0;
+    uint64_t now = timer_now(kbd->event);
+    uint64_t mac;
+    int r;
+
+    if (oversized(kbd, n))
+        return -EMSGSIZE;
+
+    /*
+     * A phone retrying a write it saw no reply to; the first one counts.
+     * That may have been typed already, and then the phone is done.
+     */
+    mac = dedup_mac(&kbd->dedup, device, records, n);
+    if (dedup_seen(&kbd->dedup, mac, now)) {
+        stats.duplicates_suppressed++;
+        if (!queued(kbd, device))
+            connection_typed(device);
+        return 1;
+    }
+
+    /*
+     * Turned away before it can supersede or displace anything, so that a
+     * phone keeps its older code if the newer one is refused. Tokens are
+     * only taken once the codes are queued: a phone retrying against a
+     * full queue must not limit itself.
+     */
+    r = keyboard_check(kbd, device, n);
+    if (r == -EBUSY)
+        stats.rate_limited++;
+    else if (r < 0)
+        stats.queue_rejected++;
+    if (r < 0)
+        return r;
+
+    if (kbd->supersede)
+        supersede(kbd, device);
+
+    if (kbd->count + n > kbd->depth && kbd->full == QUEUE_FULL_BLOCK) {
+        enqueue(kbd, call, device, records, n);
+        ratelimit_take(&kbd->limits, device, now, n);
+        dedup_add(&kbd->dedup, mac, now);
+        start(kbd);
+        return 0;
+    }
+
+    /* Never the code being typed, which is already on screen. */
+    while (kbd->count + n > kbd->depth) {
+        stats.queue_dropped++;
+        finish(kbd, oldest, -ECANCELED);
+    }
+
+    enqueue(kbd, NULL, device, records, n);
+    ratelimit_take(&kbd->limits, device, now, n);
+    dedup_add(&kbd->dedup, mac, now);
+    start(kbd);
+    return 1;
+}
+
+/*
+ * Whether keyboard_type() would turn n codes from device away now, without
+ * taking anything: 0 if not, or the negative errno it would return.
+ */
+int
+keyboard_check(struct keyboard *kbd, const char *device, size_t n)
+{
+    size_t oldest = kbd->typing ? 1 : 0;
+    size_t count = kbd->count;
+
+    if (oversized(kbd, n))
+        return -EMSGSIZE;
+
+    if (!ratelimit_check(&kbd->limits, device, timer_now(kbd->event), n))
+        return -EBUSY;
+
+    /* The queued codes it would supersede make room. */
+    for (size_t i = oldest; kbd->supersede && i < kbd->count; i++) {
+        if (strcmp(at(kbd, i)->device, device) == 0)
+            count--;
+    }
+
+    if (count + n <= kbd->depth)
+        return 0;
+
+    switch (kbd->full) {
+    case QUEUE_FULL_DROP_OLDEST:
+        return oldest + n <= kbd->depth ? 0 : -ENOBUFS;
+
+    case QUEUE_FULL_REJECT:
+        return -ENOBUFS;
+
+    case QUEUE_FULL_BLOCK:
+        return count + n <= PENDING_MAX ? 0 : -ENOBUFS;
+    }
+
+    return 0;
+}
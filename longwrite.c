@@ -0,0 +1,219 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <errno.h>
+
+/*
+ * A value too long for one ATT write arrives as prepared writes. Once they
+ * are executed, bluetoothd hands them over as WriteValue calls marked
+ * "reliable": since 5.50 merged into one, before that one per chunk at
+ * increasing offsets. Each chunk but the last fills the MTU; as a value may
+ * end on a full chunk too, a quiet spell also ends it.
+ *
+ * Only prepared writes are put together, and every chunk is checked as it
+ * arrives, so that its write fails if the value cannot be typed. A value
+ * that ends on a full chunk is flushed with no write left to answer: a
+ * chunk is only acknowledged if the value would be typed were it the last.
+ */
+#define ASSEMBLY_USEC 100000ULL
+
+/* ATT_MTU less the opcode and handle, and the offset of a prepared write. */
+#define WRITE_HEADER 3
+#define PREPARE_HEADER 5
+
+static void
+discard(struct assembly *a)
+{
+    timer_stop(&a->flush);
+    memset(a->bytes, 0, a->size);
+    a->size = 0;
+    a->device[0] = '\0';
+    a->used = false;
+}
+
+static int
+type(struct keyboard *kbd, sd_bus_message *call, const char *device,
+     const uint8_t *value, size_t size)
+{
+    struct record records[PENDING_MAX];
+    int n;
+
+    n = frame_parse(value, size, records);
+    if (n < 0)
+        return n;
+
+    return keyboard_type(kbd, call, device, records, n);
+}
+
+static int
+on_flush(sd_event_source *s, uint64_t usec, void *misc)
+{
+    struct assembly *a = misc;
+    int r;
+
+    /*
+     * Every chunk has been acknowledged, so there is no one to tell. The
+     * last was checked, so only a queue filled since then gets here.
+     */
+    a->used = false; /* Complete: no longer being put together. */
+    r = type(a->kbd, NULL, a->device, a->bytes, a->size);
+    if (r < 0)
+        fprintf(stderr, "Dropped long write: %s\n", strerror(-r));
+
+    discard(a);
+    return 0;
+}
+
+static struct assembly *
+find(struct keyboard *kbd, const char *device)
+{
+    for (size_t i = 0; i < ASSEMBLY_MAX; i++) {
+        struct assembly *a = &kbd->assemblies[i];
+
+        if (a->used && strncmp(a->device, device, DEVICE_MAX - 1) == 0)
+            return a;
+    }
+
+    return NULL;
+}
+
+static struct assembly *
+claim(struct keyboard *kbd, const char *device)
+{
+    for (size_t i = 0; i < ASSEMBLY_MAX; i++) {
+        struct assembly *a = &kbd->assemblies[i];
+
+        if (a->used)
+            continue;
+
+        a->used = true;
+        strncpy(a->device, device, DEVICE_MAX - 1);
+        return a;
+    }
+
+    return NULL;
+}
+
+void
+longwrite_init(struct keyboard *kbd)
+{
+    for (size_t i = 0; i < ASSEMBLY_MAX; i++) {
+        kbd->assemblies[i] = (struct assembly) {
+            .flush = { .handler = on_flush, .userdata = &kbd->assemblies[i] },
+            .kbd = kbd,
+        };
+    }
+}
+
+void
+longwrite_cleanup(struct keyboard *kbd)
+{
+    for (size_t i = 0; i < ASSEMBLY_MAX; i++) {
+        discard(&kbd->assemblies[i]);
+        timer_cleanup(&kbd->assemblies[i].flush);
+    }
+}
+
+/* The largest chunk one write may carry under opts. */
+size_t
+longwrite_chunk(const struct write_options *opts)
+{
+    if (opts->prepared)
+        return VALUE_MAX;
+
+    if (opts->mtu <= WRITE_HEADER)
+        return OTP_MAX;
+
+    return opts->mtu - WRITE_HEADER;
+}
+
+/* Whether size fills a prepared write, so that more may follow. */
+static bool
+full(const struct write_options *opts, size_t size)
+{
+    /* Without the MTU a full chunk cannot be told apart: no long writes. */
+    return opts->mtu > PREPARE_HEADER &&
+           size == (size_t) opts->mtu - PREPARE_HEADER;
+}
+
+/*
+ * Takes one chunk. A value that fits in one write is typed at once;
+ * otherwise the chunk is checked, appended to the device's buffer and 1
+ * is returned. Otherwise as keyboard_type(), or as frame_parse() for a
+ * value that does not parse, -EINVAL for a chunk at an unexpected offset,
+ * -EMSGSIZE for a value too long and -ENOSPC if too many devices are
+ * sending long writes at once.
+ */
+int
+longwrite(struct keyboard *kbd, sd_bus_message *call,
+          const struct write_options *opts, const uint8_t *bytes, size_t size)
+{
+    struct assembly *a = find(kbd, opts->device);
+    struct record records[PENDING_MAX];
+    int r;
+
+    /* The chunk comes again once the write is executed. */
+    if (opts->authorize)
+        return 1;
+
+    if (opts->offset == 0) {
+        if (a != NULL)
+            discard(a);
+
+        if (!opts->prepared || !full(opts, size))
+            return type(kbd, call, opts->device, bytes, size);
+
+        a = claim(kbd, opts->device);
+        if (a == NULL)
+            return -ENOSPC;
+    } else if (a == NULL || opts->offset != a->size) {
+        return -EINVAL;
+    }
+
+    if (size > VALUE_MAX - a->size) {
+        discard(a);
+        return -EMSGSIZE;
+    }
+
+    memcpy(&a->bytes[a->size], bytes, size);
+    a->size += size;
+    if (!full(opts, size)) {
+        a->used = false; /* Complete: no longer being put together. */
+        r = type(kbd, call, a->device, a->bytes, a->size);
+        discard(a);
+        return r;
+    }
+
+    r = frame_prefix(a->bytes, a->size, records);
+    if (r > 0)
+        r = keyboard_check(kbd, a->device, r);
+    if (r == -EAGAIN)
+        r = 0;
+    if (r == 0)
+        r = timer_start(&a->flush, kbd->event, ASSEMBLY_USEC);
+    if (r < 0) {
+        discard(a);
+        return r;
+    }
+
+    return 1;
+}
@@ -0,0 +1,108 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <string.h>
+
+/*
+ * One token bucket per device, counted in microseconds of credit: each
+ * code costs one interval, credit accrues in real time and is capped at
+ * burst intervals. With more devices than buckets, the bucket closest to
+ * full is reused, which forgives the least.
+ */
+
+static uint64_t
+credit(const struct ratelimit *rl, const struct bucket *b, uint64_t now)
+{
+    uint64_t cap = rl->burst * rl->interval;
+
+    if (now - b->at >= cap - b->credit)
+        return cap;
+
+    return b->credit + (now - b->at);
+}
+
+void
+ratelimit_init(struct ratelimit *rl, uint64_t interval, uint64_t burst)
+{
+    *rl = (struct ratelimit) { .interval = interval, .burst = burst };
+}
+
+/* Takes cost tokens for device, returning false if it has too few. */
+bool
+ratelimit_take(struct ratelimit *rl, const char *device, uint64_t now,
+               uint64_t cost)
+{
+    struct bucket *b = NULL;
+    uint64_t c;
+
+    if (rl->interval == 0)
+        return true;
+
+    for (size_t i = 0; i < BUCKET_MAX; i++) {
+        struct bucket *e = &rl->buckets[i];
+
+        if (e->used && strncmp(e->device, device, DEVICE_MAX - 1) == 0) {
+            b = e;
+            break;
+        }
+
+        if (b == NULL || (b->used && !e->used) ||
+            (b->used && credit(rl, e, now) > credit(rl, b, now)))
+            b = e;
+    }
+
+    if (!b->used || strncmp(b->device, device, DEVICE_MAX - 1) != 0) {
+        *b = (struct bucket) {
+            .credit = rl->burst * rl->interval, .at = now, .used = true
+        };
+        strncpy(b->device, device, DEVICE_MAX - 1);
+    }
+
+    c = credit(rl, b, now);
+    b->at = now;
+    if (cost > rl->burst || c < cost * rl->interval) {
+        b->credit = c;
+        return false;
+    }
+
+    b->credit = c - cost * rl->interval;
+    return true;
+}
+
+/* Whether device has cost tokens, without taking them. */
+bool
+ratelimit_check(const struct ratelimit *rl, const char *device, uint64_t now,
+                uint64_t cost)
+{
+    if (rl->interval == 0)
+        return true;
+
+    if (cost > rl->burst)
+        return false;
+
+    for (size_t i = 0; i < BUCKET_MAX; i++) {
+        const struct bucket *b = &rl->buckets[i];
+
+        if (b->used && strncmp(b->device, device, DEVICE_MAX - 1) == 0)
+            return credit(rl, b, now) >= cost * rl->interval;
+    }
+
+    /* A device without a bucket gets a full one. */
+    return true;
+}
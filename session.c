@@ -0,0 +1,271 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <error.h>
+
+#define LOGIN_NAME "org.freedesktop.login1"
+#define LOGIN_PATH "/org/freedesktop/login1"
+#define SEAT_IFACE "org.freedesktop.login1.Seat"
+#define SESSION_IFACE "org.freedesktop.login1.Session"
+
+#define LOGIN_MATCH \
+    "type='signal',sender='org.freedesktop.login1'," \
+    "interface='org.freedesktop.DBus.Properties'," \
+    "member='PropertiesChanged',path_namespace='/org/freedesktop/login1'"
+
+/*
+ * Follows the active session on our seat through logind, so that only a
+ * computer someone is sitting at advertises. Any change to the seat or
+ * its session re-reads all of its properties: they change rarely, and a
+ * snapshot cannot be half applied. If logind cannot be asked, advertising
+ * carries on regardless.
+ */
+
+static struct {
+    sd_bus *bus;
+    char *seat;
+    char session[DEVICE_MAX];
+    bool known;
+    bool failed;
+    bool graphical;
+    bool remote;
+    bool active;
+    bool locked;
+    bool idle;
+} login;
+
+static void
+update(void)
+{
+    bool allowed = true;
+
+    if (login.known) {
+        allowed = login.session[0] != '\0' && login.graphical &&
+                  !login.remote && login.active && !login.locked;
+        if (config.adv_when == ADV_WHEN_PRESENT && login.idle)
+            allowed = false;
+    }
+
+    advertising_allow(allowed);
+}
+
+/* Reads a variant holding a boolean into a bool. */
+static int
+boolean(sd_bus_message *m, bool *value)
+{
+    int b = false;
+    int r;
+
+    r = sd_bus_message_read(m, "v", "b", &b);
+    if (r >= 0)
+        *value = b;
+
+    return r;
+}
+
+static int
+session_prop(sd_bus_message *m, const char *key)
+{
+    const char *type = NULL;
+    int r;
+
+    if (strcmp(key, "Type") == 0) {
+        r = sd_bus_message_read(m, "v", "s", &type);
+        if (r >= 0)
+            login.graphical = strcmp(type, "x11") == 0 ||
+                              strcmp(type, "wayland") == 0 ||
+                              strcmp(type, "mir") == 0;
+        return r;
+    }
+
+    if (strcmp(key, "Remote") == 0)
+        return boolean(m, &login.remote);
+
+    if (strcmp(key, "Active") == 0)
+        return boolean(m, &login.active);
+
+    if (strcmp(key, "LockedHint") == 0)
+        return boolean(m, &login.locked);
+
+    if (strcmp(key, "IdleHint") == 0)
+        return boolean(m, &login.idle);
+
+    return sd_bus_message_skip(m, "v");
+}
+
+static int
+seat_prop(sd_bus_message *m, const char *key)
+{
+    const char *path = NULL;
+    int r;
+
+    if (strcmp(key, "ActiveSession") != 0)
+        return sd_bus_message_skip(m, "v");
+
+    r = sd_bus_message_read(m, "v", "(so)", NULL, &path);
+    if (r < 0)
+        return r;
+
+    if (strcmp(path, "/") == 0)
+        path = "";
+
+    snprintf(login.session, sizeof(login.session), "%s", path);
+    return r;
+}
+
+/* Walks the a{sv} of a GetAll reply, handing each entry to prop(). */
+static int
+properties(sd_bus_message *m, int (*prop)(sd_bus_message *, const char *))
+{
+    int r;
+
+    r = sd_bus_message_enter_container(m, 'a', "{sv}");
+    if (r < 0)
+        return r;
+
+    while ((r = sd_bus_message_enter_container(m, 'e', "sv")) > 0) {
+        const char *key = NULL;
+
+        r = sd_bus_message_read(m, "s", &key);
+        if (r < 0)
+            return r;
+
+        r = prop(m, key);
+        if (r < 0)
+            return r;
+
+        r = sd_bus_message_exit_container(m);
+        if (r < 0)
+            return r;
+    }
+    if (r < 0)
+        return r;
+
+    return sd_bus_message_exit_container(m);
+}
+
+static void
+unknown(const char *what, const sd_bus_error *err)
+{
+    if (!login.failed)
+        fprintf(stderr, "Error reading %s from logind: %s; advertising "
+                "regardless\n", what, err ? err->message : "bad reply");
+
+    login.failed = true;
+    login.known = false;
+    update();
+}
+
+static int
+on_session(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    if (sd_bus_error_is_set(ret_error)) {
+        unknown("session", ret_error);
+        return 0;
+    }
+
+    if (properties(m, session_prop) < 0) {
+        unknown("session", NULL);
+        return 0;
+    }
+
+    login.failed = false;
+    login.known = true;
+    update();
+    return 0;
+}
+
+static void
+fetch(const char *path, const char *iface, sd_bus_message_handler_t handler)
+{
+    int r;
+
+    r = sd_bus_call_method_async(login.bus, NULL, LOGIN_NAME, path,
+                                 "org.freedesktop.DBus.Properties", "GetAll",
+                                 handler, NULL, "s", iface);
+    if (r < 0)
+        fprintf(stderr, "Error asking logind about %s: %s\n", path,
+                strerror(-r));
+}
+
+static int
+on_seat(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    if (sd_bus_error_is_set(ret_error)) {
+        unknown("seat", ret_error);
+        return 0;
+    }
+
+    if (properties(m, seat_prop) < 0) {
+        unknown("seat", NULL);
+        return 0;
+    }
+
+    if (login.session[0] != '\0') {
+        fetch(login.session, SESSION_IFACE, on_session);
+        return 0;
+    }
+
+    login.failed = false;
+    login.known = true;
+    update();
+    return 0;
+}
+
+static int
+on_changed(sd_bus_message *m, void *misc, sd_bus_error *ret_error)
+{
+    const char *path = sd_bus_message_get_path(m);
+
+    if (!path)
+        return 0;
+
+    if (strcmp(path, login.seat) == 0)
+        fetch(login.seat, SEAT_IFACE, on_seat);
+    else if (strcmp(path, login.session) == 0)
+        fetch(login.session, SESSION_IFACE, on_session);
+
+    return 0;
+}
+
+void
+setup_session(sd_bus *bus)
+{
+    int r;
+
+    if (config.adv_when == ADV_WHEN_ALWAYS)
+        return;
+
+    r = sd_bus_path_encode(LOGIN_PATH "/seat", config.seat, &login.seat);
+    if (r < 0)
+        error(EXIT_FAILURE, -r, "Error naming seat %s", config.seat);
+
+    r = sd_bus_add_match_async(bus, NULL, LOGIN_MATCH, on_changed, NULL,
+                               NULL);
+    if (r < 0)
+        fprintf(stderr, "Error watching logind: %s\n", strerror(-r));
+
+    login.bus = bus;
+    fetch(login.seat, SEAT_IFACE, on_seat);
+}
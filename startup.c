@@ -0,0 +1,114 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include <systemd/sd-daemon.h>
+
+/*
+ * Startup milestones, in the order they are normally reached. Phases that
+ * overlap (uinput creation runs while GetManagedObjects is in flight) are
+ * reported as offsets from the start of main() rather than as durations.
+ */
+static const char *names[STARTUP_PHASES] = {
+    [STARTUP_MAIN] = "main",
+    [STARTUP_BUS] = "bus",
+    [STARTUP_QUERY] = "query-sent",
+    [STARTUP_UINPUT] = "uinput",
+    [STARTUP_OBJECTS] = "objects",
+    [STARTUP_ADAPTERS] = "adapters",
+    [STARTUP_APPLICATION] = "application",
+    [STARTUP_ADVERTISING] = "advertising",
+};
+
+static uint64_t marks[STARTUP_PHASES];
+
+static uint64_t
+now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+report(void)
+{
+    char buf[512];
+    size_t len = 0;
+
+    for (size_t i = STARTUP_BUS; i < STARTUP_PHASES; i++) {
+        if (marks[i] == 0)
+            continue;
+
+        len += snprintf(&buf[len], sizeof(buf) - len, " %s=%.1fms",
+                        names[i], (marks[i] - marks[STARTUP_MAIN]) / 1000.0);
+        if (len >= sizeof(buf))
+            break;
+    }
+
+    fprintf(stderr, "Startup profile:%s\n", buf);
+}
+
+void
+startup_mark(enum startup_phase phase)
+{
+    if (marks[phase] != 0)
+        return;
+
+    marks[phase] = now_us();
+
+    switch (phase) {
+    case STARTUP_ADAPTERS:
+        /* Adapters present at startup have been asked to register us. */
+        sd_notify(false, "READY=1");
+        break;
+
+    case STARTUP_ADVERTISING:
+        report();
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+ * Everything after connecting to the bus. Once this returns, the daemon
+ * does nothing until bluez, a phone or a timer it armed wakes it: there are
+ * no periodic wakeups while idle.
+ */
+void
+setup_daemon(sd_bus *bus, sd_event *event, struct keyboard *kbd)
+{
+    /* Query bluez first; everything below overlaps with its reply. */
+    setup_registration(bus);
+
+    keyboard_init(kbd, event);
+
+    setup_objects(bus, kbd);
+    setup_advertising(bus, event);
+    setup_session(bus);
+    setup_connections(bus, event);
+    setup_connparam(bus, event);
+    setup_stats(bus, event);
+    startup_mark(STARTUP_OBJECTS);
+}
@@ -0,0 +1,153 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define STATS_IFACE "org.freeotp.Jelling.Stats1"
+
+#define STAT(name, field) \
+    SD_BUS_PROPERTY(name, "t", NULL, offsetof(struct stats, field), 0)
+
+#define HISTOGRAM(name, field) \
+    SD_BUS_PROPERTY(name, "at", histogram, offsetof(struct stats, field), 0)
+
+#define PER_ADAPTER(name, field) \
+    SD_BUS_PROPERTY(name, "a{ot}", per_adapter, \
+                    offsetof(struct stats, field), 0)
+
+struct stats stats;
+
+void
+histogram_add(struct histogram *h, uint64_t usec)
+{
+    uint64_t ms = usec / 1000;
+    size_t i = 0;
+
+    while (ms > 0 && i + 1 < HISTOGRAM_BUCKETS) {
+        ms >>= 1;
+        i++;
+    }
+
+    h->buckets[i]++;
+}
+
+static int
+histogram(sd_bus *bus, const char *path, const char *interface,
+          const char *property, sd_bus_message *reply, void *userdata,
+          sd_bus_error *ret_error)
+{
+    const struct histogram *h = userdata;
+
+    return sd_bus_message_append_array(reply, 't', h->buckets,
+                                       sizeof(h->buckets));
+}
+
+/* Reads one of the per-adapter arrays, keyed by adapter path. */
+static int
+per_adapter(sd_bus *bus, const char *path, const char *interface,
+            const char *property, sd_bus_message *reply, void *userdata,
+            sd_bus_error *ret_error)
+{
+    const uint64_t *values = userdata;
+    int r;
+
+    r = sd_bus_message_open_container(reply, 'a', "{ot}");
+    if (r < 0)
+        return r;
+
+    for (size_t i = 0; i < ADAPTER_MAX && stats.adapters[i][0]; i++) {
+        r = sd_bus_message_append(reply, "{ot}", stats.adapters[i],
+                                  values[i]);
+        if (r < 0)
+            return r;
+    }
+
+    return sd_bus_message_close_container(reply);
+}
+
+/* Plain counters: read on demand, never announced with signals. */
+static const sd_bus_vtable stats_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    STAT("UinputWriteFailures", uinput_failures),
+    STAT("UinputRecreations", uinput_recreations),
+    STAT("UinputRecreateLastUSec", uinput_recreate_last_usec),
+    STAT("UinputRecreateMaxUSec", uinput_recreate_max_usec),
+    STAT("UinputRecreateTotalUSec", uinput_recreate_total_usec),
+    STAT("PendingExpired", pending_expired),
+    STAT("QueueRejected", queue_rejected),
+    STAT("QueueDropped", queue_dropped),
+    STAT("Superseded", superseded),
+    STAT("DuplicatesSuppressed", duplicates_suppressed),
+    STAT("RateLimited", rate_limited),
+    STAT("AdvertisingBursts", adv_bursts),
+    STAT("AdvertisingFastUSec", adv_fast_usec),
+    STAT("AdvertisingSlowUSec", adv_slow_usec),
+    STAT("AdvertisingPausedUSec", adv_paused_usec),
+    STAT("DiscoveryLastUSec", discovery_last_usec),
+    STAT("DiscoveryMaxUSec", discovery_max_usec),
+    STAT("ConnectWriteLastUSec", connect_write_last_usec),
+    STAT("ConnectWriteMaxUSec", connect_write_max_usec),
+    STAT("Disconnects", disconnects),
+    PER_ADAPTER("Connections", connections),
+    PER_ADAPTER("ConnectionsMax", connections_max),
+    PER_ADAPTER("ConnectionSlotsExhausted", slots_exhausted),
+    HISTOGRAM("ResolveHistogram", resolve_hist),
+    HISTOGRAM("PairHistogram", pair_hist),
+    HISTOGRAM("WriteHistogram", write_hist),
+    HISTOGRAM("TypeHistogram", type_hist),
+    HISTOGRAM("ConnectedHistogram", connected_hist),
+    STAT("Wakeups", wakeups),
+    STAT("TimerWakeups", timer_wakeups),
+    SD_BUS_VTABLE_END
+};
+
+/*
+ * Post sources run once after every loop iteration that dispatched
+ * anything else, so this counts the wakeups that did work.
+ */
+static int
+on_wakeup(sd_event_source *s, void *misc)
+{
+    stats.wakeups++;
+    return 0;
+}
+
+void
+setup_stats(sd_bus *bus, sd_event *event)
+{
+    static sd_event_source *wakeups;
+    int r;
+
+    r = sd_event_add_post(event, &wakeups, on_wakeup, NULL);
+    if (r >= 0)
+        r = sd_event_source_set_enabled(wakeups, SD_EVENT_ON);
+    if (r < 0)
+        fprintf(stderr, "Error counting wakeups: %s\n", strerror(-r));
+
+    r = sd_bus_add_object_vtable(bus, NULL, STATS_PATH, STATS_IFACE,
+                                 stats_vtable, &stats);
+    if (r < 0)
+        fprintf(stderr, "Error exporting statistics: %s\n", strerror(-r));
+
+    /* Only makes the statistics easier to find, so failure is fine. */
+    r = sd_bus_request_name_async(bus, NULL, BUS_NAME, 0, NULL, NULL);
+    if (r < 0)
+        fprintf(stderr, "Error requesting %s: %s\n", BUS_NAME, strerror(-r));
+}
@@ -0,0 +1,130 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <time.h>
+
+/*
+ * Every daemon timer goes through here so they all follow one policy:
+ * timers are one-shot, never periodic, and may fire up to a quarter of
+ * their delay late (between 1 ms and 1 s). sd-event uses that slack to
+ * coalesce them with each other and with whatever else wakes the system.
+ * Precise timers, such as key pacing, get only the 1 ms minimum.
+ */
+#define SLACK_MIN_USEC 1000ULL
+#define SLACK_MAX_USEC 1000000ULL
+
+static int
+on_timer(sd_event_source *s, uint64_t usec, void *misc)
+{
+    struct timer *t = misc;
+
+    stats.timer_wakeups++;
+    return t->handler(s, usec, t->userdata);
+}
+
+static uint64_t
+loop_now(sd_event *event)
+{
+    uint64_t usec = 0;
+
+    if (event)
+        sd_event_now(event, CLOCK_MONOTONIC, &usec);
+
+    return usec;
+}
+
+/* Without a loop (as in the harness keyboard) timers never fire. */
+static int
+loop_start(struct timer *t, sd_event *event, uint64_t delay)
+{
+    uint64_t slack = t->precise ? 0 : delay / 4;
+    uint64_t now;
+    int r;
+
+    if (!event)
+        return 0;
+
+    if (slack < SLACK_MIN_USEC)
+        slack = SLACK_MIN_USEC;
+    if (slack > SLACK_MAX_USEC)
+        slack = SLACK_MAX_USEC;
+
+    r = sd_event_now(event, CLOCK_MONOTONIC, &now);
+    if (r < 0)
+        return r;
+
+    if (!t->source) {
+        return sd_event_add_time(event, &t->source, CLOCK_MONOTONIC,
+                                 now + delay, slack, on_timer, t);
+    }
+
+    r = sd_event_source_set_time(t->source, now + delay);
+    if (r < 0)
+        return r;
+
+    r = sd_event_source_set_time_accuracy(t->source, slack);
+    if (r < 0)
+        return r;
+
+    return sd_event_source_set_enabled(t->source, SD_EVENT_ONESHOT);
+}
+
+static void
+loop_stop(struct timer *t)
+{
+    if (t->source)
+        sd_event_source_set_enabled(t->source, SD_EVENT_OFF);
+}
+
+static const struct clock loop = {
+    .now = loop_now,
+    .start = loop_start,
+    .stop = loop_stop,
+};
+
+const struct clock *timebase = &loop;
+
+uint64_t
+timer_now(sd_event *event)
+{
+    return timebase->now(event);
+}
+
+int
+timer_start(struct timer *t, sd_event *event, uint64_t delay)
+{
+    return timebase->start(t, event, delay);
+}
+
+void
+timer_stop(struct timer *t)
+{
+    timebase->stop(t);
+}
+
+void
+timer_cleanup(struct timer *t)
+{
+    if (t == NULL)
+        return;
+
+    timer_stop(t);
+    sd_event_source_unref(t->source);
+    t->source = NULL;
+}
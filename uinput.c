@@ -0,0 +1,164 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Authors: Nathaniel McCallum <npmccallum@redhat.com>
+ *
+ * Copyright (C) 2015  Nathaniel McCallum, Red Hat
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <stdlib.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <linux/uinput.h>
+
+#define UINPUT_NAME "Jelling"
+#define UINPUT_ID { \
+    .bustype = BUS_USB, \
+    .vendor = 0xef0f, \
+    .product = 0xd746, \
+    .version = 1 \
+}
+
+void
+uinput_cleanup(uinput *i)
+{
+    if (i == NULL || *i < 0)
+        return;
+
+    ioctl(*i, UI_DEV_DESTROY);
+    close(*i);
+}
+
+/* Writes the frame for one key transition; pacing is up to the caller. */
+int
+event(uinput input, uint16_t k, bool down)
+{
+    struct input_event evts[2];
+    size_t n;
+
+    n = event_frame(evts, k, down);
+    for (size_t i = 0; i < n; i++) {
+        ssize_t r = write(input, &evts[i], sizeof(evts[i]));
+        if (r < 0)
+            return -errno;
+    }
+
+    return 0;
+}
+
+/*
+ * Describes the device with UI_DEV_SETUP (Linux 4.5), falling back to
+ * writing a struct uinput_user_dev on older kernels.
+ */
+static int
+describe(uinput fd)
+{
+    static const struct uinput_user_dev dev = {
+        .name = UINPUT_NAME,
+        .id = UINPUT_ID,
+    };
+
+#ifdef UI_DEV_SETUP
+    static const struct uinput_setup setup = {
+        .name = UINPUT_NAME,
+        .id = UINPUT_ID,
+    };
+
+    if (ioctl(fd, UI_DEV_SETUP, &setup) == 0)
+        return 0;
+
+    if (errno != EINVAL && errno != ENOTTY)
+        return -errno;
+#endif
+
+    if (write(fd, &dev, sizeof(dev)) < 0)
+        return -errno;
+
+    return 0;
+}
+
+/*
+ * Creates the device, returning a negative errno instead of exiting: the
+ * keyboard retries until it succeeds.
+ */
+int
+uinput_open(uinput *input)
+{
+    /*
+     * devtmpfs creates /dev/uinput on every current system, so it comes
+     * first and a normal start makes no failed lookup. The other nodes are
+     * kept for older setups. Only a missing node moves on to the next; any
+     * other error, such as a lack of permission, is returned as it is.
+     */
+    static const char *devices[] = {
+        "/dev/uinput",
+        "/dev/input/uinput",
+        "/dev/misc/uinput",
+        NULL
+    };
+
+    SCOPED(uinput) fd = -1;
+    int r;
+
+    for (size_t i = 0; fd < 0 && devices[i]; i++) {
+        fd = open(devices[i], O_WRONLY | O_CLOEXEC);
+        if (fd < 0 && errno != ENOENT)
+            return -errno;
+    }
+    if (fd < 0)
+        return -ENOENT;
+
+    r = ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    if (r < 0)
+        return -errno;
+
+    r = ioctl(fd, UI_SET_EVBIT, EV_SYN);
+    if (r < 0)
+        return -errno;
+
+    /*
+     * EV_REP is deliberately never set: without it the kernel arms no
+     * autorepeat timer for the device, however slowly keys are paced.
+     */
+
+    for (uint8_t c = 0; c < UINT8_MAX; c++) {
+        uint16_t k = char2key(c);
+        if (k == KEY_UNKNOWN) {
+            if (c != '\n')
+                continue;
+            k = KEY_ENTER;
+        }
+
+        r = ioctl(fd, UI_SET_KEYBIT, k);
+        if (r < 0)
+            return -errno;
+    }
+
+    r = describe(fd);
+    if (r < 0)
+        return r;
+
+    r = ioctl(fd, UI_DEV_CREATE);
+    if (r < 0)
+        return -errno;
+
+    *input = fd;
+    fd = -1;
+    return 0;
+}
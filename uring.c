@@ -0,0 +1,217 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/*
+ * Copyright (C) 2026  Jelling Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jelling.h"
+
+#include <errno.h>
+
+#include <liburing.h>
+
+/*
+ * Types a whole code with a single io_uring submission: a linked chain in
+ * which every frame write is followed by a timeout that holds the next
+ * write back by the key pacing. The kernel does the pacing. Every step but
+ * the last completes silently (IOSQE_CQE_SKIP_SUCCESS), and a failure
+ * cancels the rest of the chain silently too, so a chain always ends in
+ * exactly one completion: the ring fd turns readable once per code.
+ *
+ * Timeouts only let the chain continue when they expire if they carry
+ * IORING_TIMEOUT_ETIME_SUCCESS (Linux 5.16), and skipping completions needs
+ * Linux 5.17. The ring is set up and probed on first use; if that fails,
+ * everything here returns -EOPNOTSUPP from then on and keyboard.c paces
+ * the keys itself.
+ */
+
+#define FRAMES (2 * (OTP_MAX + 1) + 1)
+#define ENTRIES 256
+#define LAST UINT64_MAX
+#define CANCEL (UINT64_MAX - 1)
+
+static struct io_uring ring;
+static int state; /* 0: not tried yet, 1: usable, -1: unavailable */
+static bool busy;
+
+/* Static: the kernel reads them after uring_submit() has returned. */
+static struct input_event frames[FRAMES][2];
+
+static int
+probe(void)
+{
+    struct __kernel_timespec ts = { .tv_nsec = 1 };
+    struct io_uring_cqe *cqe;
+    struct io_uring_sqe *sqe;
+    int r;
+
+    r = io_uring_queue_init(ENTRIES, &ring, 0);
+    if (r < 0)
+        return r;
+
+    r = -EOPNOTSUPP;
+    if (ring.features & IORING_FEAT_CQE_SKIP) {
+        sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_timeout(sqe, &ts, 0, IORING_TIMEOUT_ETIME_SUCCESS);
+        r = io_uring_submit_and_wait(&ring, 1);
+    }
+    if (r >= 0)
+        r = io_uring_wait_cqe(&ring, &cqe);
+    if (r >= 0) {
+        r = cqe->res == -ETIME ? 0 : -EOPNOTSUPP;
+        io_uring_cqe_seen(&ring, cqe);
+    }
+
+    if (r < 0)
+        io_uring_queue_exit(&ring);
+
+    return r;
+}
+
+static bool
+ready(void)
+{
+    if (state == 0)
+        state = probe() < 0 ? -1 : 1;
+
+    return state > 0;
+}
+
+static void
+disable(void)
+{
+    io_uring_queue_exit(&ring);
+    state = -1;
+    busy = false;
+}
+
+/* Queues one frame write and the pause after it; returns the pause. */
+static struct io_uring_sqe *
+queue(uinput input, size_t f, uint16_t k, bool down)
+{
+    static struct __kernel_timespec pace = {
+        .tv_nsec = PACE_USEC * 1000
+    };
+    size_t len = event_frame(frames[f], k, down) * sizeof(*frames[f]);
+    struct io_uring_sqe *sqe;
+
+    /* The expected length is the tag: short writes are errors too. */
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_write(sqe, input, frames[f], len, 0);
+    io_uring_sqe_set_data64(sqe, len);
+    io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK | IOSQE_CQE_SKIP_SUCCESS);
+
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_timeout(sqe, &pace, 0, IORING_TIMEOUT_ETIME_SUCCESS);
+    io_uring_sqe_set_data64(sqe, 0);
+    io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK | IOSQE_CQE_SKIP_SUCCESS);
+    return sqe;
+}
+
+/* The fd to poll for the completion of a submitted code. */
+int
+uring_fd(void)
+{
+    return ready() ? ring.ring_fd : -EOPNOTSUPP;
+}
+
+/* Starts typing a code; one at a time, collected with uring_reap(). */
+int
+uring_submit(uinput input, const uint8_t *bytes, size_t size, bool enter)
+{
+    struct io_uring_sqe *last;
+    size_t f = 0;
+    int r;
+
+    if (!ready() || size > OTP_MAX)
+        return -EOPNOTSUPP;
+    if (busy)
+        return -EBUSY;
+
+    /* The same frames, in the same order, as keyboard.c would write. */
+    for (size_t i = 0; i < size + enter; i++) {
+        uint16_t k = i < size ? char2key(bytes[i]) : KEY_ENTER;
+        queue(input, f++, k, true);
+        queue(input, f++, k, false);
+    }
+    last = queue(input, f++, KEY_UNKNOWN, false);
+    io_uring_sqe_set_flags(last, 0);
+    io_uring_sqe_set_data64(last, LAST);
+
+    r = io_uring_submit(&ring);
+    if (r < 0) {
+        /* Nothing was submitted, so nothing was typed either. */
+        disable();
+        return -EOPNOTSUPP;
+    }
+
+    busy = true;
+    return 0;
+}
+
+/*
+ * Returns the result of the submitted code once the chain has ended, or
+ * -EAGAIN while it is still being typed.
+ */
+int
+uring_reap(void)
+{
+    struct io_uring_cqe *cqe;
+    uint64_t tag;
+    int r;
+
+    do {
+        if (!busy || io_uring_peek_cqe(&ring, &cqe) < 0)
+            return -EAGAIN;
+
+        /* A cancel that came too late to find anything. */
+        tag = io_uring_cqe_get_data64(cqe);
+        if (tag == CANCEL)
+            io_uring_cqe_seen(&ring, cqe);
+    } while (tag == CANCEL);
+
+    if (tag == LAST)
+        r = cqe->res == -ETIME ? 0 : cqe->res;
+    else if (tag == 0 || cqe->res < 0)
+        r = cqe->res < 0 ? cqe->res : -EIO;
+    else
+        r = -EIO; /* A short write. */
+
+    io_uring_cqe_seen(&ring, cqe);
+    busy = false;
+    return r;
+}
+
+/*
+ * Stops the submitted chain at the pause it is in; uring_reap() then
+ * returns -ECANCELED, or 0 if the chain had already reached its end.
+ */
+int
+uring_cancel(void)
+{
+    struct io_uring_sqe *sqe;
+    int r;
+
+    if (!busy)
+        return -EALREADY;
+
+    /* Only the pause being waited on is in flight; all pauses are 0. */
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_cancel64(sqe, 0, 0);
+    io_uring_sqe_set_data64(sqe, CANCEL);
+    io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+
+    r = io_uring_submit(&ring);
+    return r < 0 ? r : 0;
+}